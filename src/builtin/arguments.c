@@ -11,7 +11,7 @@
 
 // MARK: - Private
 
-struct Object * Arguments(prototype);
+Ecc(threadLocal) struct Object * Arguments(prototype);
 
 const struct Object(Type) Arguments(type) = {
 	.text = &Text(argumentsType),
@@ -15,8 +15,8 @@
 
 // MARK: - Private
 
-struct Object * Array(prototype) = NULL;
-struct Function * Array(constructor) = NULL;
+Ecc(threadLocal) struct Object * Array(prototype) = NULL;
+Ecc(threadLocal) struct Function * Array(constructor) = NULL;
 
 const struct Object(Type) Array(type) = {
 	.text = &Text(arrayType),
@@ -99,7 +99,7 @@ struct Value toChars (struct Context * const context, struct Value this, struct
 		value = Object.getElement(context, this.data.object, index);
 		
 		if (index)
-			Chars.append(&chars, "%.*s", separator.length, separator.bytes);
+			Chars.appendBytes(&chars, separator.bytes, separator.length);
 		
 		if (value.type != Value(undefinedType) && value.type != Value(nullType))
 			Chars.appendValue(&chars, context, value);
@@ -419,6 +419,7 @@ void rotate(struct Object *object, struct Context *context, uint32_t first, uint
 static inline
 int compare (struct Compare *cmp, struct Value left, struct Value right)
 {
+	struct Value result;
 	uint16_t hashmapCount;
 	
 	if (left.check != 1)
@@ -451,10 +452,15 @@ int compare (struct Compare *cmp, struct Value left, struct Value right)
 	}
 	
 	cmp->context.ops = cmp->ops;
+	cmp->context.breaker = 0;
 	cmp->arguments->element[0].value = left;
 	cmp->arguments->element[1].value = right;
 	
-	return Value.toInteger(&cmp->context, cmp->context.ops->native(&cmp->context)).data.integer < 0;
+	cmp->context.ecc->current = &cmp->context;
+	result = cmp->context.ops->native(&cmp->context);
+	cmp->context.ecc->current = cmp->context.parent;
+	
+	return Value.toInteger(&cmp->context, result).data.integer < 0;
 }
 
 static inline
@@ -617,7 +623,12 @@ struct Value sort (struct Context * const context)
 	compare = Context.argument(context, 0);
 	
 	if (compare.type == Value(functionType))
+	{
+		if (compare.data.function->flags & Function(needCompile))
+			Op.compileFunction(context, compare.data.function);
+		
 		sortInPlace(context, this, compare.data.function, 0, count);
+	}
 	else if (compare.type == Value(undefinedType))
 		sortInPlace(context, this, NULL, 0, count);
 	else
@@ -17,8 +17,8 @@
 
 	#include "global.h"
 
-	extern struct Object * Array(prototype);
-	extern struct Function * Array(constructor);
+	extern Ecc(threadLocal) struct Object * Array(prototype);
+	extern Ecc(threadLocal) struct Function * Array(constructor);
 	extern const struct Object(Type) Array(type);
 
 #endif
@@ -13,8 +13,8 @@
 
 // MARK: - Private
 
-struct Object * Boolean(prototype) = NULL;
-struct Function * Boolean(constructor) = NULL;
+Ecc(threadLocal) struct Object * Boolean(prototype) = NULL;
+Ecc(threadLocal) struct Function * Boolean(constructor) = NULL;
 
 const struct Object(Type) Boolean(type) = {
 	.text = &Text(booleanType),
@@ -17,8 +17,8 @@
 
 	#include "global.h"
 
-	extern struct Object * Boolean(prototype);
-	extern struct Function * Boolean(constructor);
+	extern Ecc(threadLocal) struct Object * Boolean(prototype);
+	extern Ecc(threadLocal) struct Function * Boolean(constructor);
 	extern const struct Object(Type) Boolean(type);
 
 #endif
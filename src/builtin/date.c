@@ -15,8 +15,8 @@
 
 // MARK: - Private
 
-struct Object * Date(prototype) = NULL;
-struct Function * Date(constructor) = NULL;
+Ecc(threadLocal) struct Object * Date(prototype) = NULL;
+Ecc(threadLocal) struct Function * Date(constructor) = NULL;
 
 const struct Object(Type) Date(type) = {
 	.text = &Text(dateType),
@@ -35,7 +35,7 @@ struct time {
 	int32_t ms;
 };
 
-static double localOffset;
+static Ecc(threadLocal) double localOffset;
 
 static const double msPerSecond = 1000;
 static const double msPerMinute = 60000;
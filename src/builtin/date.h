@@ -17,8 +17,8 @@
 
 	#include "global.h"
 
-	extern struct Object * Date(prototype);
-	extern struct Function * Date(constructor);
+	extern Ecc(threadLocal) struct Object * Date(prototype);
+	extern Ecc(threadLocal) struct Function * Date(constructor);
 	extern const struct Object(Type) Date(type);
 
 #endif
@@ -13,21 +13,21 @@
 
 // MARK: - Private
 
-struct Object * Error(prototype) = NULL;
-struct Object * Error(rangePrototype) = NULL;
-struct Object * Error(referencePrototype) = NULL;
-struct Object * Error(syntaxPrototype) = NULL;
-struct Object * Error(typePrototype) = NULL;
-struct Object * Error(uriPrototype) = NULL;
-struct Object * Error(evalPrototype) = NULL;
+Ecc(threadLocal) struct Object * Error(prototype) = NULL;
+Ecc(threadLocal) struct Object * Error(rangePrototype) = NULL;
+Ecc(threadLocal) struct Object * Error(referencePrototype) = NULL;
+Ecc(threadLocal) struct Object * Error(syntaxPrototype) = NULL;
+Ecc(threadLocal) struct Object * Error(typePrototype) = NULL;
+Ecc(threadLocal) struct Object * Error(uriPrototype) = NULL;
+Ecc(threadLocal) struct Object * Error(evalPrototype) = NULL;
 
-struct Function * Error(constructor) = NULL;
-struct Function * Error(rangeConstructor) = NULL;
-struct Function * Error(referenceConstructor) = NULL;
-struct Function * Error(syntaxConstructor) = NULL;
-struct Function * Error(typeConstructor) = NULL;
-struct Function * Error(uriConstructor) = NULL;
-struct Function * Error(evalConstructor) = NULL;
+Ecc(threadLocal) struct Function * Error(constructor) = NULL;
+Ecc(threadLocal) struct Function * Error(rangeConstructor) = NULL;
+Ecc(threadLocal) struct Function * Error(referenceConstructor) = NULL;
+Ecc(threadLocal) struct Function * Error(syntaxConstructor) = NULL;
+Ecc(threadLocal) struct Function * Error(typeConstructor) = NULL;
+Ecc(threadLocal) struct Function * Error(uriConstructor) = NULL;
+Ecc(threadLocal) struct Function * Error(evalConstructor) = NULL;
 
 const struct Object(Type) Error(type) = {
 	.text = &Text(errorType),
@@ -43,7 +43,7 @@ struct Chars *messageValue (struct Context * const context, struct Value value)
 	if (value.type == Value(undefinedType))
 		return NULL;
 	else if (value.type == Value(charsType))
-		return value.data.chars;
+		return Chars.flatten(value.data.chars);
 	else
 	{
 		value = Value.toString(context, value);
@@ -17,21 +17,21 @@
 
 	#include "global.h"
 
-	extern struct Object * Error(prototype);
-	extern struct Object * Error(rangePrototype);
-	extern struct Object * Error(referencePrototype);
-	extern struct Object * Error(syntaxPrototype);
-	extern struct Object * Error(typePrototype);
-	extern struct Object * Error(uriPrototype);
-	extern struct Object * Error(evalPrototype);
-
-	extern struct Function * Error(constructor);
-	extern struct Function * Error(rangeConstructor);
-	extern struct Function * Error(referenceConstructor);
-	extern struct Function * Error(syntaxConstructor);
-	extern struct Function * Error(typeConstructor);
-	extern struct Function * Error(uriConstructor);
-	extern struct Function * Error(evalConstructor);
+	extern Ecc(threadLocal) struct Object * Error(prototype);
+	extern Ecc(threadLocal) struct Object * Error(rangePrototype);
+	extern Ecc(threadLocal) struct Object * Error(referencePrototype);
+	extern Ecc(threadLocal) struct Object * Error(syntaxPrototype);
+	extern Ecc(threadLocal) struct Object * Error(typePrototype);
+	extern Ecc(threadLocal) struct Object * Error(uriPrototype);
+	extern Ecc(threadLocal) struct Object * Error(evalPrototype);
+
+	extern Ecc(threadLocal) struct Function * Error(constructor);
+	extern Ecc(threadLocal) struct Function * Error(rangeConstructor);
+	extern Ecc(threadLocal) struct Function * Error(referenceConstructor);
+	extern Ecc(threadLocal) struct Function * Error(syntaxConstructor);
+	extern Ecc(threadLocal) struct Function * Error(typeConstructor);
+	extern Ecc(threadLocal) struct Function * Error(uriConstructor);
+	extern Ecc(threadLocal) struct Function * Error(evalConstructor);
 
 	extern const struct Object(Type) Error(type);
 
@@ -19,15 +19,16 @@ static va_list empty_ap;
 
 static void mark (struct Object *object);
 static void capture (struct Object *object);
+static void finalize (struct Object *object);
 
-struct Object * Function(prototype) = NULL;
-struct Function * Function(constructor) = NULL;
+Ecc(threadLocal) struct Object * Function(prototype) = NULL;
+Ecc(threadLocal) struct Function * Function(constructor) = NULL;
 
 const struct Object(Type) Function(type) = {
 	.text = &Text(functionType),
 	.mark = mark,
 	.capture = capture,
-	/* XXX: don't finalize */
+	.finalize = finalize,
 };
 
 static
@@ -46,6 +47,8 @@ static
 void mark (struct Object *object)
 {
 	struct Function *self = (struct Function *)object;
+	struct Object *prototype = self->object.prototype;
+	uint32_t index, count;
 	
 	Pool.markObject(&self->environment);
 	
@@ -54,6 +57,22 @@ void mark (struct Object *object)
 	
 	if (self->pair)
 		Pool.markObject(&self->pair->object);
+	
+	// nested function templates are only referenced by the ops; closures leave them to their template
+	if (self->oplist && !(prototype && prototype->type == &Function(type) && ((struct Function *)prototype)->oplist == self->oplist))
+		for (index = 0, count = self->oplist->count; index < count; ++index)
+			if (self->oplist->ops[index].value.type >= Value(objectType))
+				Pool.markValue(self->oplist->ops[index].value);
+}
+
+static
+void finalize (struct Object *object)
+{
+	struct Function *self = (struct Function *)object;
+	
+	/* a function waiting for compilation owns its environment, copies included */
+	if (self->flags & Function(needCompile))
+		free(self->environment.hashmap), self->environment.hashmap = NULL;
 }
 
 // MARK: - Static Members
@@ -75,7 +94,7 @@ struct Value toChars (struct Context * const context, struct Value value)
 	if (self->text.bytes == Text(nativeCode).bytes)
 		Chars.append(&chars, "() [native code]");
 	else
-		Chars.append(&chars, "%.*s", self->text.length, self->text.bytes);
+		Chars.appendBytes(&chars, self->text.bytes, self->text.length);
 	
 	return Chars.endAppend(&chars);
 }
@@ -163,8 +182,11 @@ struct Value bindCall (struct Context * const context)
 	length = (function->environment.elementCount - 1) + count;
 	arguments = Array.createSized(length);
 	
-	memcpy(arguments->element, function->environment.element + 1, sizeof(*arguments->element) * (function->environment.elementCount - 1));
-	memcpy(arguments->element + (function->environment.elementCount - 1), context->environment->hashmap[2].value.data.object->element, sizeof(*arguments->element) * (context->environment->hashmap[2].value.data.object->elementCount));
+	if (function->environment.elementCount > 1)
+		memcpy(arguments->element, function->environment.element + 1, sizeof(*arguments->element) * (function->environment.elementCount - 1));
+	
+	if (count)
+		memcpy(arguments->element + (function->environment.elementCount - 1), context->environment->hashmap[2].value.data.object->element, sizeof(*arguments->element) * (context->environment->hashmap[2].value.data.object->elementCount));
 	
 	return Op.callFunctionArguments(context, 0, context->this.data.function->pair, function->environment.element[0].value, arguments);
 }
@@ -231,7 +253,7 @@ struct Value constructor (struct Context * const context)
 					Chars.append(&chars, "){");
 				
 				value = Value.toString(context, Context.argument(context, index));
-				Chars.append(&chars, "%.*s", Value.stringLength(&value), Value.stringBytes(&value));
+				Chars.appendBytes(&chars, Value.stringBytes(&value), Value.stringLength(&value));
 				
 				if (index < argumentCount - 2)
 					Chars.append(&chars, ",");
@@ -309,6 +331,7 @@ struct Function * createWithNative (const Native(Function) native, int parameter
 	}
 	
 	self->environment.hashmapCount = self->environment.hashmapCapacity;
+	self->flags |= Function(isNative);
 	self->oplist = OpList.create(native, Value(undefined), Text(nativeCode));
 	self->text = Text(nativeCode);
 	
@@ -331,6 +354,13 @@ struct Function * copy (struct Function *original)
 	self->object.hashmap = malloc(byteSize);
 	memcpy(self->object.hashmap, original->object.hashmap, byteSize);
 	
+	if (original->flags & Function(needCompile))
+	{
+		byteSize = sizeof(*self->environment.hashmap) * self->environment.hashmapCapacity;
+		self->environment.hashmap = malloc(byteSize);
+		memcpy(self->environment.hashmap, original->environment.hashmap, byteSize);
+	}
+	
 	return self;
 }
 
@@ -25,10 +25,13 @@
 		Function(needArguments) = 1 << 2,
 		Function(useBoundThis)  = 1 << 3,
 		Function(strictMode)    = 1 << 4,
+		Function(isNative)      = 1 << 5,
+		Function(needCompile)   = 1 << 6,
+		Function(sloppyMode)    = 1 << 7,
 	};
 
-	extern struct Object * Function(prototype);
-	extern struct Function * Function(constructor);
+	extern Ecc(threadLocal) struct Object * Function(prototype);
+	extern Ecc(threadLocal) struct Function * Function(constructor);
 	extern const struct Object(Type) Function(type);
 
 #endif
@@ -110,6 +110,49 @@ struct Text string (struct Parse *parse)
 	return text;
 }
 
+static
+struct Value unescape (struct Text text)
+{
+	struct Chars(Append) chars;
+	int32_t index;
+	
+	if (!memchr(text.bytes, '\\', text.length))
+		return Value.chars(Chars.createWithBytes(text.length, text.bytes));
+	
+	Chars.beginAppend(&chars);
+	
+	for (index = 0; index < text.length; ++index)
+	{
+		if (text.bytes[index] != '\\' || index + 1 >= text.length)
+		{
+			Chars.appendBytes(&chars, text.bytes + index, 1);
+			continue;
+		}
+		
+		switch (text.bytes[++index])
+		{
+			case 'b': Chars.append(&chars, "\b"); break;
+			case 'f': Chars.append(&chars, "\f"); break;
+			case 'n': Chars.append(&chars, "\n"); break;
+			case 'r': Chars.append(&chars, "\r"); break;
+			case 't': Chars.append(&chars, "\t"); break;
+			case 'u':
+				if (index + 4 < text.length)
+				{
+					Chars.appendCodepoint(&chars, Lexer.uint16Hex(text.bytes[index + 1], text.bytes[index + 2], text.bytes[index + 3], text.bytes[index + 4]));
+					index += 4;
+					break;
+				}
+				/*vvv*/
+				
+			default:
+				Chars.appendBytes(&chars, text.bytes + index, 1);
+				break;
+		}
+	}
+	return Chars.endAppend(&chars);
+}
+
 static struct Value object (struct Parse *parse);
 static struct Value array (struct Parse *parse);
 
@@ -157,6 +200,7 @@ struct Value literal (struct Parse *parse)
 		case '9':
 		{
 			struct Text text = Text.make(parse->text.bytes - 1, 1);
+			int integral = 1;
 			
 			if (c.codepoint == '-')
 				c = Text.nextCharacter(&parse->text);
@@ -173,6 +217,7 @@ struct Value literal (struct Parse *parse)
 			
 			if (c.codepoint == '.')
 			{
+				integral = 0;
 				while (parse->text.length)
 				{
 					c = Text.nextCharacter(&parse->text);
@@ -183,6 +228,7 @@ struct Value literal (struct Parse *parse)
 			
 			if (c.codepoint == 'e' || c.codepoint == 'E')
 			{
+				integral = 0;
 				c = Text.nextCharacter(&parse->text);
 				if (c.codepoint == '+' || c.codepoint == '-')
 					c = Text.nextCharacter(&parse->text);
@@ -198,13 +244,16 @@ struct Value literal (struct Parse *parse)
 			Text.advance(&parse->text, -c.units);
 			text.length = (int32_t)(parse->text.bytes - text.bytes);
 			
+			// -0 needs a binary to keep its sign
+			if (integral && !(text.length == 2 && text.bytes[0] == '-' && text.bytes[1] == '0'))
+				return Lexer.scanInteger(text, 10, 0);
+			
 			return Lexer.scanBinary(text, 0);
 		}
 			
 		case '"':
 		{
-			struct Text text = string(parse);
-			return Value.chars(Chars.createWithBytes(text.length, text.bytes));
+			return unescape(string(parse));
 			break;
 		}
 			
@@ -225,6 +274,7 @@ struct Value object (struct Parse *parse)
 	struct Object *object = Object.create(Object(prototype));
 	struct Text(Char) c;
 	struct Value value;
+	struct Text text;
 	struct Key key;
 	
 	c = nextc(parse);
@@ -234,7 +284,13 @@ struct Value object (struct Parse *parse)
 			if (c.codepoint != '"')
 				return error(parse, -c.units, Chars.create("expect property name"));
 			
-			key = Key.makeWithText(string(parse), Key(copyOnCreate));
+			text = string(parse);
+			if (memchr(text.bytes, '\\', text.length))
+			{
+				value = unescape(text);
+				text = Text.make(Value.stringBytes(&value), Value.stringLength(&value));
+			}
+			key = Key.makeWithText(text, Key(copyOnCreate));
 			
 			c = nextc(parse);
 			if (c.codepoint != ':')
@@ -330,7 +386,12 @@ struct Value revive (struct Parse *parse, struct Value this, struct Value proper
 	parse->context.this = this;
 	parse->arguments->element[0].value = property;
 	parse->arguments->element[1].value = value;
-	return parse->context.ops->native(&parse->context);
+	
+	parse->context.ecc->current = &parse->context;
+	value = parse->context.ops->native(&parse->context);
+	parse->context.ecc->current = parse->context.parent;
+	
+	return value;
 }
 
 static
@@ -348,7 +409,7 @@ struct Value walker (struct Parse *parse, struct Value this, struct Value proper
 			if (object->element[index].value.check == 1)
 			{
 				Chars.beginAppend(&chars);
-				Chars.append(&chars, "%d", index);
+				Chars.appendInt32(&chars, index);
 				object->element[index].value = walker(parse, this, Chars.endAppend(&chars), object->element[index].value);
 			}
 		}
@@ -362,6 +423,29 @@ struct Value walker (struct Parse *parse, struct Value this, struct Value proper
 	return revive(parse, this, property, value);
 }
 
+static
+struct Value parseText (struct Context * const context, struct Parse *parse)
+{
+	struct Value result = json(parse);
+	
+	if (result.type != Value(errorType) && parse->text.length)
+	{
+		struct Text(Char) c = Text.character(parse->text);
+		result = error(parse, c.units, Chars.create("unexpected '%.*s'", c.units, parse->text.bytes));
+	}
+	
+	if (result.type == Value(errorType))
+	{
+		Context.setTextIndex(context, Context(noIndex));
+		context->ecc->ofLine = parse->line;
+		context->ecc->ofText = errorOfLine(parse);
+		context->ecc->ofInput = "(parse)";
+		Context.throw(context, result);
+	}
+	
+	return result;
+}
+
 static
 struct Value jsonParse (struct Context * const context)
 {
@@ -382,24 +466,12 @@ struct Value jsonParse (struct Context * const context)
 	parse.start = parse.text.bytes;
 	parse.line = 1;
 	parse.function = reviver.type == Value(functionType)? reviver.data.function: NULL;
-	parse.ops = parse.function? parse.function->oplist->ops: NULL;
-	
-	result = json(&parse);
+	if (parse.function && parse.function->flags & Function(needCompile))
+		Op.compileFunction(context, parse.function);
 	
-	if (result.type != Value(errorType) && parse.text.length)
-	{
-		struct Text(Char) c = Text.character(parse.text);
-		result = error(&parse, c.units, Chars.create("unexpected '%.*s'", c.units, parse.text.bytes));
-	}
+	parse.ops = parse.function? parse.function->oplist->ops: NULL;
 	
-	if (result.type == Value(errorType))
-	{
-		Context.setTextIndex(context, Context(noIndex));
-		context->ecc->ofLine = parse.line;
-		context->ecc->ofText = errorOfLine(&parse);
-		context->ecc->ofInput = "(parse)";
-		Context.throw(context, result);
-	}
+	result = parseText(context, &parse);
 	
 	if (parse.function && parse.function->flags & Function(needHeap))
 	{
@@ -434,6 +506,47 @@ struct Value jsonParse (struct Context * const context)
 	return result;
 }
 
+static
+void appendQuoted (struct Chars(Append) *chars, const char *bytes, int32_t length)
+{
+	int32_t index, start = 0;
+	const char *escape;
+	
+	Chars.reserveAppend(chars, length + 2);
+	Chars.appendBytes(chars, "\"", 1);
+	
+	for (index = 0; index < length; ++index)
+	{
+		switch (bytes[index])
+		{
+			case '"': escape = "\\\""; break;
+			case '\\': escape = "\\\\"; break;
+			case '\b': escape = "\\b"; break;
+			case '\f': escape = "\\f"; break;
+			case '\n': escape = "\\n"; break;
+			case '\r': escape = "\\r"; break;
+			case '\t': escape = "\\t"; break;
+			default:
+				if ((unsigned char)bytes[index] >= 0x20)
+					continue;
+				
+				escape = NULL;
+		}
+		
+		Chars.appendBytes(chars, bytes + start, index - start);
+		
+		if (escape)
+			Chars.appendBytes(chars, escape, 2);
+		else
+			Chars.append(chars, "\\u%04x", (unsigned char)bytes[index]);
+		
+		start = index + 1;
+	}
+	
+	Chars.appendBytes(chars, bytes + start, length - start);
+	Chars.appendBytes(chars, "\"", 1);
+}
+
 static
 struct Value replace (struct Stringify *stringify, struct Value this, struct Value property, struct Value value)
 {
@@ -462,7 +575,12 @@ struct Value replace (struct Stringify *stringify, struct Value this, struct Val
 	stringify->context.this = this;
 	stringify->arguments->element[0].value = property;
 	stringify->arguments->element[1].value = value;
-	return stringify->context.ops->native(&stringify->context);
+	
+	stringify->context.ecc->current = &stringify->context;
+	value = stringify->context.ops->native(&stringify->context);
+	stringify->context.ecc->current = stringify->context.parent;
+	
+	return value;
 }
 
 static
@@ -501,16 +619,23 @@ int stringifyValue (struct Stringify *stringify, struct Value this, struct Value
 	}
 	
 	if (addComa)
-		Chars.append(&stringify->chars, ",%s", strlen(stringify->spaces)? "\n": "");
+		Chars.appendBytes(&stringify->chars, ",\n", stringify->spaces[0]? 2: 1);
 	
 	for (index = 0, count = stringify->level; index < count; ++index)
-		Chars.append(&stringify->chars, "%s", stringify->spaces);
+		Chars.appendBytes(&stringify->chars, stringify->spaces, (int32_t)strlen(stringify->spaces));
 	
 	if (!isArray)
-		Chars.append(&stringify->chars, "\"%.*s\":%s", Value.stringLength(&property), Value.stringBytes(&property), strlen(stringify->spaces)? " ": "");
+	{
+		appendQuoted(&stringify->chars, Value.stringBytes(&property), Value.stringLength(&property));
+		Chars.appendBytes(&stringify->chars, ": ", stringify->spaces[0]? 2: 1);
+	}
 	
 	if (value.type == Value(functionType) || value.type == Value(undefinedType))
 		Chars.append(&stringify->chars, "null");
+	else if (value.type == Value(binaryType) && !isfinite(value.data.binary))
+		Chars.append(&stringify->chars, "null");
+	else if (Value.isString(value))
+		appendQuoted(&stringify->chars, Value.stringBytes(&value), Value.stringLength(&value));
 	else if (Value.isObject(value))
 	{
 		struct Object *object = value.data.object;
@@ -519,7 +644,7 @@ int stringifyValue (struct Stringify *stringify, struct Value this, struct Value
 		const struct Text *property;
 		int hasValue = 0;
 		
-		Chars.append(&stringify->chars, "%s%s", isArray? "[": "{", strlen(stringify->spaces)? "\n": "");
+		Chars.appendBytes(&stringify->chars, isArray? "[\n": "{\n", stringify->spaces[0]? 2: 1);
 		++stringify->level;
 		
 		for (index = 0, count = object->elementCount < Object(ElementMax)? object->elementCount: Object(ElementMax); index < count; ++index)
@@ -527,7 +652,7 @@ int stringifyValue (struct Stringify *stringify, struct Value this, struct Value
 			if (object->element[index].value.check == 1)
 			{
 				Chars.beginAppend(&chars);
-				Chars.append(&chars, "%d", index);
+				Chars.appendInt32(&chars, index);
 				hasValue |= stringifyValue(stringify, value, Chars.endAppend(&chars), object->element[index].value, isArray, hasValue);
 			}
 		}
@@ -544,13 +669,14 @@ int stringifyValue (struct Stringify *stringify, struct Value this, struct Value
 			}
 		}
 		
-		Chars.append(&stringify->chars, "%s", strlen(stringify->spaces)? "\n": "");
+		if (stringify->spaces[0])
+			Chars.appendBytes(&stringify->chars, "\n", 1);
 		
 		--stringify->level;
 		for (index = 0, count = stringify->level; index < count; ++index)
-			Chars.append(&stringify->chars, "%s", stringify->spaces);
+			Chars.appendBytes(&stringify->chars, stringify->spaces, (int32_t)strlen(stringify->spaces));
 		
-		Chars.append(&stringify->chars, "%s", isArray? "]": "}");
+		Chars.appendBytes(&stringify->chars, isArray? "]": "}", 1);
 	}
 	else
 		Chars.appendValue(&stringify->chars, &stringify->context, value);
@@ -578,6 +704,9 @@ struct Value jsonStringify (struct Context * const context)
 	
 	stringify.filter = replacer.type == Value(objectType) && replacer.data.object->type == &Array(type)? replacer.data.object: NULL;
 	stringify.function = replacer.type == Value(functionType)? replacer.data.function: NULL;
+	if (stringify.function && stringify.function->flags & Function(needCompile))
+		Op.compileFunction(context, stringify.function);
+	
 	stringify.ops = stringify.function? stringify.function->oplist->ops: NULL;
 	
 	if (Value.isString(space))
@@ -636,7 +765,7 @@ struct Value jsonStringify (struct Context * const context)
 
 // MARK: - Public
 
-struct Object * JSON(object) = NULL;
+Ecc(threadLocal) struct Object * JSON(object) = NULL;
 
 void setup ()
 {
@@ -652,3 +781,29 @@ void teardown (void)
 {
 	JSON(object) = NULL;
 }
+
+struct Value parse (struct Context * const context, struct Text text)
+{
+	struct Parse parse = {
+		.text = text,
+		.start = text.bytes,
+		.line = 1,
+	};
+	
+	return parseText(context, &parse);
+}
+
+struct Value stringify (struct Context * const context, struct Value value)
+{
+	struct Stringify stringify = {
+		.context = {
+			.parent = context,
+			.ecc = context->ecc,
+			.depth = context->depth + 1,
+		},
+	};
+	
+	Chars.beginAppend(&stringify.chars);
+	stringifyValue(&stringify, value, Value.text(&Text(empty)), value, 1, 0);
+	return Chars.endAppend(&stringify.chars);
+}
@@ -17,7 +17,7 @@
 
 	#include "global.h"
 
-	extern struct Object * JSON(object);
+	extern Ecc(threadLocal) struct Object * JSON(object);
 	extern const struct Object(Type) JSON(type);
 
 #endif
@@ -27,6 +27,9 @@ Interface(JSON,
 	
 	(void, setup ,(void))
 	(void, teardown ,(void))
+	
+	(struct Value, parse ,(struct Context * const, struct Text text))
+	(struct Value, stringify ,(struct Context * const, struct Value value))
 	,
 	{
 		char empty;
@@ -260,7 +260,7 @@ struct Value mathTan (struct Context * const context)
 
 // MARK: - Public
 
-struct Object * Math(object) = NULL;
+Ecc(threadLocal) struct Object * Math(object) = NULL;
 
 void setup ()
 {
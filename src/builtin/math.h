@@ -17,7 +17,7 @@
 
 	#include "global.h"
 
-	extern struct Object * Math(object);
+	extern Ecc(threadLocal) struct Object * Math(object);
 	extern const struct Object(Type) Math(type);
 
 #endif
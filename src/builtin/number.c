@@ -14,8 +14,8 @@
 
 // MARK: - Private
 
-struct Object * Number(prototype) = NULL;
-struct Function * Number(constructor) = NULL;
+Ecc(threadLocal) struct Object * Number(prototype) = NULL;
+Ecc(threadLocal) struct Function * Number(constructor) = NULL;
 
 const struct Object(Type) Number(type) = {
 	.text = &Text(numberType),
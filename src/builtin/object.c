@@ -20,8 +20,8 @@ const uint32_t Object(ElementMax) = 0xffffff;
 
 static const int defaultSize = 8;
 
-struct Object * Object(prototype) = NULL;
-struct Function * Object(constructor) = NULL;
+Ecc(threadLocal) struct Object * Object(prototype) = NULL;
+Ecc(threadLocal) struct Function * Object(constructor) = NULL;
 
 const struct Object(Type) Object(type) = {
 	.text = &Text(objectType),
@@ -29,6 +29,13 @@ const struct Object(Type) Object(type) = {
 
 // MARK: - Static Members
 
+static inline
+void unshare (struct Object *self)
+{
+	if (self->flags & Object(shared))
+		Ecc.unshareObject(self);
+}
+
 static inline
 uint16_t getSlot (const struct Object * const self, const struct Key key)
 {
@@ -512,6 +519,7 @@ struct Value seal (struct Context * const context)
 	uint32_t index, count;
 	
 	object = checkObject(context, 0);
+	unshare(object);
 	object->flags |= Object(sealed);
 	
 	for (index = 0, count = elementCount(object); index < count; ++index)
@@ -532,6 +540,7 @@ struct Value freeze (struct Context * const context)
 	uint32_t index, count;
 	
 	object = checkObject(context, 0);
+	unshare(object);
 	object->flags |= Object(sealed);
 	
 	for (index = 0, count = elementCount(object); index < count; ++index)
@@ -551,6 +560,7 @@ struct Value preventExtensions (struct Context * const context)
 	struct Object *object;
 	
 	object = checkObject(context, 0);
+	unshare(object);
 	object->flags |= Object(sealed);
 	
 	return Value.object(object);
@@ -758,14 +768,17 @@ struct Object * copy (const struct Object *original)
 	Pool.addObject(self);
 	
 	*self = *original;
+	self->flags &= ~Object(shared);
 	
 	byteSize = sizeof(*self->element) * self->elementCount;
 	self->element = malloc(byteSize);
-	memcpy(self->element, original->element, byteSize);
+	if (byteSize)
+		memcpy(self->element, original->element, byteSize);
 	
 	byteSize = sizeof(*self->hashmap) * self->hashmapCount;
 	self->hashmap = malloc(byteSize);
-	memcpy(self->hashmap, original->hashmap, byteSize);
+	if (byteSize)
+		memcpy(self->hashmap, original->hashmap, byteSize);
 	
 	return self;
 }
@@ -920,6 +933,7 @@ struct Value putValue (struct Context *context, struct Object *self, struct Valu
 			value.flags = ref->flags;
 	}
 	
+	unshare(self);
 	return *ref = value;
 }
 
@@ -991,6 +1005,8 @@ struct Value * addMember (struct Object *self, struct Key key, struct Value valu
 	
 	assert(self);
 	
+	unshare(self);
+	
 	do
 	{
 		if (!self->hashmap[slot].slot[key.data.depth[depth]])
@@ -1038,6 +1054,8 @@ struct Value * addElement (struct Object *self, uint32_t index, struct Value val
 	
 	assert(self);
 	
+	unshare(self);
+	
 	if (self->elementCapacity <= index)
 		resizeElement(self, index < UINT32_MAX? index + 1: index);
 	else if (self->elementCount <= index)
@@ -1073,6 +1091,8 @@ int deleteMember (struct Object *self, struct Key member)
 	assert(object);
 	assert(member.data.integer);
 	
+	unshare(self);
+	
 	refSlot =
 		self->hashmap[
 		self->hashmap[
@@ -1112,6 +1132,7 @@ int deleteElement (struct Object *self, uint32_t index)
 		if (self->element[index].value.flags & Value(sealed))
 			return 0;
 		
+		unshare(self);
 		memset(&self->element[index], 0, sizeof(*self->element));
 	}
 	
@@ -1136,6 +1157,8 @@ void packValue (struct Object *self)
 	
 	assert(self);
 	
+	unshare(self);
+	
 	for (; index < self->hashmapCount; ++index)
 		if (self->hashmap[index].value.check == 1)
 		{
@@ -1172,6 +1195,8 @@ void stripMap (struct Object *self)
 	
 	assert(self);
 	
+	unshare(self);
+	
 	while (index < self->hashmapCount && self->hashmap[index].value.check == 1)
 		++index;
 	
@@ -1187,6 +1212,8 @@ void reserveSlots (struct Object *self, uint16_t slots)
 	
 	assert(slots < self->hashmapCapacity);
 	
+	unshare(self);
+	
 	if (need > 0)
 	{
 		uint16_t capacity = self->hashmapCapacity;
@@ -1224,6 +1251,8 @@ int resizeElement (struct Object *self, uint32_t size)
 	
 	assert(self);
 	
+	unshare(self);
+	
 	if (capacity != self->elementCapacity)
 	{
 		if (size > Object(ElementMax))
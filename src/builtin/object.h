@@ -30,10 +30,11 @@
 	{
 		Object(mark) = 1 << 0,
 		Object(sealed) = 1 << 1,
+		Object(shared) = 1 << 2,
 	};
 
-	extern struct Object * Object(prototype);
-	extern struct Function * Object(constructor);
+	extern Ecc(threadLocal) struct Object * Object(prototype);
+	extern Ecc(threadLocal) struct Function * Object(constructor);
 	extern const struct Object(Type) Object(type);
 	
 	extern const uint32_t Object(ElementMax);
@@ -19,8 +19,8 @@ static void mark (struct Object *object);
 static void capture (struct Object *object);
 static void finalize (struct Object *object);
 
-struct Object * RegExp(prototype) = NULL;
-struct Function * RegExp(constructor) = NULL;
+Ecc(threadLocal) struct Object * RegExp(prototype) = NULL;
+Ecc(threadLocal) struct Function * RegExp(constructor) = NULL;
 
 const struct Object(Type) RegExp(type) = {
 	.text = &Text(regexpType),
@@ -698,7 +698,7 @@ struct RegExp(Node) * alternative (struct Parse *p, struct Error **error)
 			{
 				struct RegExp(Node) *redo;
 				uint16_t index, count = nlen(t) - (lazy? 1: 0), length = 3;
-				char buffer[count + length];
+				char buffer[count + length + 1];
 				
 				for (index = (lazy? 1: 0); index < count; ++index)
 					if (t[index].opcode == opSave)
@@ -1118,7 +1118,6 @@ struct Value exec (struct Context * const context)
 		const char *bytes = Value.stringBytes(&value);
 		const char *capture[self->count * 2];
 		const char *index[self->count * 2];
-		struct Chars *element;
 		
 		struct RegExp(State) state = {
 			String.textAtIndex(bytes, length, lastIndex.data.integer, 0).bytes,
@@ -1136,8 +1135,7 @@ struct Value exec (struct Context * const context)
 			{
 				if (capture[index * 2])
 				{
-					element = Chars.createWithBytes((int32_t)(capture[index * 2 + 1] - capture[index * 2]), capture[index * 2]);
-					array->element[index].value = Value.chars(element);
+					array->element[index].value = String.sliceOf(&value, Text.make(capture[index * 2], (int32_t)(capture[index * 2 + 1] - capture[index * 2])));
 				}
 				else
 					array->element[index].value = Value(undefined);
@@ -1193,6 +1191,25 @@ struct Value test (struct Context * const context)
 	return Value(false);
 }
 
+static
+void prepareParse (struct Parse *p, struct Chars *s)
+{
+	p->c = s->bytes;
+	p->end = s->bytes + s->length;
+	while (p->end > p->c && *(p->end - 1) != '/')
+	{
+		switch (*(--p->end)) {
+			case 'i':
+				p->ignoreCase = 1;
+				continue;
+				
+			case 'm':
+				p->multiline = 1;
+				continue;
+		}
+	}
+}
+
 // MARK: - Methods
 
 void setup ()
@@ -1228,20 +1245,7 @@ struct RegExp * create (struct Chars *s, struct Error **error, enum RegExp(Optio
 	
 	Object.initialize(&self->object, RegExp(prototype));
 	
-	p.c = s->bytes;
-	p.end = s->bytes + s->length;
-	while (p.end > p.c && *(p.end - 1) != '/')
-	{
-		switch (*(--p.end)) {
-			case 'i':
-				p.ignoreCase = 1;
-				continue;
-				
-			case 'm':
-				p.multiline = 1;
-				continue;
-		}
-	}
+	prepareParse(&p, s);
 	
 #if DUMP_REGEXP
 	fprintf(stderr, "\n%.*s\n", s->length, s->bytes);
@@ -1377,6 +1381,17 @@ struct RegExp * createWith (struct Context *context, struct Value pattern, struc
 	return regexp;
 }
 
+void recompile (struct RegExp *self)
+{
+	struct Parse p = { 0 };
+	struct Error *error = NULL;
+	
+	assert(self);
+	
+	prepareParse(&p, self->pattern);
+	self->program = pattern(&p, &error);
+}
+
 int matchWithState (struct RegExp *self, struct RegExp(State) *state)
 {
 	int result = 0;
@@ -17,8 +17,8 @@
 
 	#include "global.h"
 
-	extern struct Object * RegExp(prototype);
-	extern struct Function * RegExp(constructor);
+	extern Ecc(threadLocal) struct Object * RegExp(prototype);
+	extern Ecc(threadLocal) struct Function * RegExp(constructor);
 	extern const struct Object(Type) RegExp(type);
 
 	struct RegExp(State) {
@@ -45,6 +45,7 @@ Interface(RegExp,
 	
 	(struct RegExp *, create ,(struct Chars *pattern, struct Error **, enum RegExp(Options)))
 	(struct RegExp *, createWith ,(struct Context *context, struct Value pattern, struct Value flags))
+	(void, recompile ,(struct RegExp *))
 	
 	(int, matchWithState ,(struct RegExp *, struct RegExp(State) *))
 	,
@@ -15,16 +15,14 @@
 // MARK: - Private
 
 static void mark (struct Object *object);
-static void capture (struct Object *object);
 static void finalize (struct Object *object);
 
-struct Object * String(prototype) = NULL;
-struct Function * String(constructor) = NULL;
+Ecc(threadLocal) struct Object * String(prototype) = NULL;
+Ecc(threadLocal) struct Function * String(constructor) = NULL;
 
 const struct Object(Type) String(type) = {
 	.text = &Text(stringType),
 	.mark = mark,
-	.capture = capture,
 	.finalize = finalize,
 };
 
@@ -37,22 +35,109 @@ void mark (struct Object *object)
 }
 
 static
-void capture (struct Object *object)
+void finalize (struct Object *object)
 {
 	struct String *self = (struct String *)object;
 	
-	++self->value->referenceCount;
+	--self->value->referenceCount;
 }
 
+// MARK: - Static Members
+
 static
-void finalize (struct Object *object)
+int32_t unitCount (const char *bytes, int32_t length)
 {
-	struct String *self = (struct String *)object;
+	int32_t index, units = 0;
 	
-	--self->value->referenceCount;
+	// every byte but continuation bytes starts a unit, and 4-byte sequences count for two
+	for (index = 0; index < length; ++index)
+		units += (((uint8_t)bytes[index] & 0xc0) != 0x80) + ((uint8_t)bytes[index] >= 0xf0);
+	
+	return units;
 }
 
-// MARK: - Static Members
+static
+struct Text walkToIndex (struct Text text, int32_t position)
+{
+	struct Text prev;
+	struct Text(Char) c;
+	
+	while (position-- > 0)
+	{
+		prev = text;
+		c = Text.nextCharacter(&text);
+		
+		if (c.codepoint > 0xffff && !position--)
+		{
+			/* simulate 16-bit surrogate */
+			text = prev;
+			text.flags = Text(breakFlag);
+		}
+	}
+	
+	return text;
+}
+
+static
+struct Text textAtCharsIndex (struct Chars *chars, int32_t position, int enableReverse)
+{
+	int32_t units = Chars.unitLength(chars), offset;
+	const char *bytes = Chars.bytesOf(chars);
+	
+	if (position < 0)
+	{
+		if (!enableReverse)
+			return Text.make(bytes, 0);
+		
+		position += units;
+		if (position < 0)
+			position = 0;
+	}
+	
+	if (position >= units)
+		return Text.make(bytes + chars->length, 0);
+	else if (chars->flags & Chars(asciiOnly))
+		return Text.make(bytes + position, chars->length - position);
+	
+	// walks at most one stride from the closest indexed character
+	offset = chars->index->marks[position / Chars(indexStride)].offset;
+	position -= chars->index->marks[position / Chars(indexStride)].unit;
+	
+	return walkToIndex(Text.make(bytes + offset, chars->length - offset), position);
+}
+
+static
+struct Chars * indexedCharsOf (const struct Value *value)
+{
+	if (value->type == Value(charsType))
+		return Chars.flatten(value->data.chars);
+	else if (value->type == Value(stringType))
+		return value->data.string->value;
+	else
+		return NULL;
+}
+
+static
+struct Text textAtValueIndex (const struct Value *value, int32_t position, int enableReverse)
+{
+	struct Chars *chars = indexedCharsOf(value);
+	
+	if (chars)
+		return textAtCharsIndex(chars, position, enableReverse);
+	else
+		return textAtIndex(Value.stringBytes(value), Value.stringLength(value), position, enableReverse);
+}
+
+static
+int32_t unitLengthOfValue (const struct Value *value)
+{
+	struct Chars *chars = indexedCharsOf(value);
+	
+	if (chars)
+		return Chars.unitLength(chars);
+	else
+		return unitIndex(Value.stringBytes(value), Value.stringLength(value), Value.stringLength(value));
+}
 
 static
 struct Value toString (struct Context * const context)
@@ -73,18 +158,15 @@ struct Value valueOf (struct Context * const context)
 static
 struct Value charAt (struct Context * const context)
 {
-	int32_t index, length;
-	const char *chars;
+	int32_t index;
 	struct Text text;
 	
 	Context.assertThisCoerciblePrimitive(context);
 	
 	context->this = Value.toString(context, context->this);
-	chars = Value.stringBytes(&context->this);
-	length = Value.stringLength(&context->this);
 	index = Value.toInteger(context, Context.argument(context, 0)).data.integer;
 	
-	text = textAtIndex(chars, length, index, 0);
+	text = textAtValueIndex(&context->this, index, 0);
 	if (!text.length)
 		return Value.text(&Text(empty));
 	else
@@ -114,18 +196,15 @@ struct Value charAt (struct Context * const context)
 static
 struct Value charCodeAt (struct Context * const context)
 {
-	int32_t index, length;
-	const char *chars;
+	int32_t index;
 	struct Text text;
 	
 	Context.assertThisCoerciblePrimitive(context);
 	
 	context->this = Value.toString(context, context->this);
-	chars = Value.stringBytes(&context->this);
-	length = Value.stringLength(&context->this);
 	index = Value.toInteger(context, Context.argument(context, 0)).data.integer;
 	
-	text = textAtIndex(chars, length, index, 0);
+	text = textAtValueIndex(&context->this, index, 0);
 	if (!text.length)
 		return Value.binary(NAN);
 	else
@@ -171,12 +250,11 @@ struct Value indexOf (struct Context * const context)
 	struct Text text;
 	struct Value search, start;
 	int32_t index, length, searchLength;
-	const char *chars, *searchChars;
+	const char *searchChars, *found;
 	
 	Context.assertThisCoerciblePrimitive(context);
 	
 	context->this = Value.toString(context, Context.this(context));
-	chars = Value.stringBytes(&context->this);
 	length = Value.stringLength(&context->this);
 	
 	search = Value.toString(context, Context.argument(context, 0));
@@ -187,22 +265,15 @@ struct Value indexOf (struct Context * const context)
 	if (index < 0)
 		index = 0;
 	
-	text = textAtIndex(chars, length, index, 0);
+	text = textAtValueIndex(&context->this, index, 0);
 	if (text.flags & Text(breakFlag))
 	{
 		Text.nextCharacter(&text);
 		++index;
 	}
 	
-	while (text.length)
-	{
-		if (!memcmp(text.bytes, searchChars, searchLength))
-			return Value.integer(index);
-		
-		++index;
-		if (Text.nextCharacter(&text).codepoint > 0xffff)
-			++index;
-	}
+	if (text.length && (found = Text.find(text, Text.make(searchChars, searchLength))))
+		return Value.integer(index + unitCount(text.bytes, (int32_t)(found - text.bytes)));
 	
 	return Value.integer(-1);
 }
@@ -212,8 +283,8 @@ struct Value lastIndexOf (struct Context * const context)
 {
 	struct Text text;
 	struct Value search, start;
-	int32_t index, length, searchLength;
-	const char *chars, *searchChars;
+	int32_t index, length, searchLength, offset;
+	const char *chars, *searchChars, *found;
 	
 	Context.assertThisCoerciblePrimitive(context);
 	
@@ -226,28 +297,20 @@ struct Value lastIndexOf (struct Context * const context)
 	searchLength = Value.stringLength(&search);
 	
 	start = Value.toBinary(context, Context.argument(context, 1));
-	index = unitIndex(chars, length, length);
+	index = unitLengthOfValue(&context->this);
 	if (!isnan(start.data.binary) && start.data.binary < index)
 		index = start.data.binary < 0? 0: start.data.binary;
 	
-	text = textAtIndex(chars, length, index, 0);
+	text = textAtValueIndex(&context->this, index, 0);
 	if (text.flags & Text(breakFlag))
 		--index;
 	
-	text.length = (int32_t)(text.bytes - chars);
+	// matches may start up to the index and run past it
+	offset = (int32_t)(text.bytes - chars);
+	found = Text.findLast(Text.make(chars, length - offset < searchLength? length: offset + searchLength), Text.make(searchChars, searchLength));
 	
-	for (;;)
-	{
-		if (length - (text.bytes - chars) >= searchLength && !memcmp(text.bytes, searchChars, searchLength))
-			return Value.integer(index);
-		
-		if (!text.length)
-			break;
-		
-		--index;
-		if (Text.prevCharacter(&text).codepoint > 0xffff)
-			--index;
-	}
+	if (found)
+		return Value.integer(index - unitCount(found, offset - (int32_t)(found - chars)));
 	
 	return Value.integer(-1);
 }
@@ -311,7 +374,7 @@ struct Value match (struct Context * const context)
 			if (RegExp.matchWithState(regexp, &state))
 			{
 				Chars.beginAppend(&chars);
-				Chars.append(&chars, "%.*s", capture[1] - capture[0], capture[0]);
+				Chars.appendBytes(&chars, capture[0], capture[1] - capture[0]);
 				Object.addElement(array, size++, Chars.endAppend(&chars), 0);
 				
 				if (!regexp->global)
@@ -323,7 +386,7 @@ struct Value match (struct Context * const context)
 						if (capture[index * 2])
 						{
 							Chars.beginAppend(&chars);
-							Chars.append(&chars, "%.*s", capture[index * 2 + 1] - capture[index * 2], capture[index * 2]);
+							Chars.appendBytes(&chars, capture[index * 2], capture[index * 2 + 1] - capture[index * 2]);
 							Object.addElement(array, size++, Chars.endAppend(&chars), 0);
 						}
 						else
@@ -356,70 +419,120 @@ struct Value match (struct Context * const context)
 	return Value(null);
 }
 
+/* replacement patterns are split once into literal runs and substitutions, then applied to every match */
+
+enum {
+	literalPart = -1,
+	matchPart = -2,
+	beforePart = -3,
+	afterPart = -4,
+};
+
+struct ReplacePart {
+	int32_t kind; // one of the above, or a capture number
+	int32_t offset;
+	int32_t length;
+};
+
 static
-void replaceText (struct Chars(Append) *chars, struct Text replace, struct Text before, struct Text match, struct Text after, int count, const char *capture[])
+struct ReplacePart * createReplaceParts (struct Text replace)
 {
-	struct Text(Char) c;
+	const char *dollar = replace.bytes, *end = replace.bytes + replace.length;
+	int32_t dollarCount = 0;
+	
+	while (( dollar = memchr(dollar, '$', end - dollar) ))
+		++dollar, ++dollarCount;
+	
+	return malloc(sizeof(struct ReplacePart) * (dollarCount * 2 + 1));
+}
+
+static
+int32_t compileReplace (struct Text replace, int count, struct ReplacePart *parts)
+{
+	const char *bytes = replace.bytes, *from = bytes, *end = replace.bytes + replace.length, *dollar;
+	int32_t partCount = 0, width, kind, number;
 	
-	while (replace.length)
+	while (( dollar = memchr(from, '$', end - from) ))
 	{
-		c = Text.character(replace);
+		kind = literalPart;
+		width = 1;
 		
-		if (c.codepoint == '$')
-		{
-			int index;
-			
-			Text.advance(&replace, 1);
-			
-			switch (Text.character(replace).codepoint)
+		if (dollar + 1 < end)
+			switch (dollar[1])
 			{
 				case '$':
-					Chars.append(chars, "$");
-					break;
-					
-				case '&':
-					Chars.append(chars, "%.*s", match.length, match.bytes);
-					break;
-					
-				case '`':
-					Chars.append(chars, "%.*s", before.length, before.bytes);
-					break;
-					
-				case '\'':
-					Chars.append(chars, "%.*s", after.length, after.bytes);
-					break;
-					
+					// the second dollar starts the next literal run
+					parts[partCount++] = (struct ReplacePart){ literalPart, (int32_t)(bytes - replace.bytes), (int32_t)(dollar + 1 - bytes) };
+					bytes = from = dollar + 2;
+					continue;
+				
+				case '&': kind = matchPart; break;
+				case '`': kind = beforePart; break;
+				case '\'': kind = afterPart; break;
+				
 				case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-					index = replace.bytes[0] - '0';
-					if (index < count)
+					// two digits when they name a capture, otherwise one
+					number = dollar + 2 < end && isdigit(dollar[2])? (dollar[1] - '0') * 10 + dollar[2] - '0': 0;
+					
+					if (number > 0 && number < count)
 					{
-						if (isdigit(replace.bytes[1]) && index * 10 <= count)
-						{
-							index = index * 10 + replace.bytes[1] - '0';
-							Text.advance(&replace, 1);
-						}
-						
-						if (capture && index && index < count)
-						{
-							if (capture[index * 2])
-								Chars.append(chars, "%.*s", capture[index * 2 + 1] - capture[index * 2], capture[index * 2]);
-							else
-								Chars.append(chars, "");
-							
-							break;
-						}
+						kind = number;
+						width = 2;
 					}
-					/* vvv */
-				default:
-					Chars.append(chars, "$");
-					continue;
+					else if (dollar[1] > '0' && dollar[1] - '0' < count)
+						kind = dollar[1] - '0';
+					
+					break;
 			}
+		
+		if (kind == literalPart)
+		{
+			// not a substitution, the dollar stays in the current literal run
+			from = dollar + 1;
+			continue;
 		}
-		else
-			Chars.append(chars, "%.*s", c.units, replace.bytes);
 		
-		Text.advance(&replace, c.units);
+		if (dollar > bytes)
+			parts[partCount++] = (struct ReplacePart){ literalPart, (int32_t)(bytes - replace.bytes), (int32_t)(dollar - bytes) };
+		
+		parts[partCount++] = (struct ReplacePart){ kind, 0, 0 };
+		bytes = from = dollar + 1 + width;
 	}
+	
+	if (end > bytes)
+		parts[partCount++] = (struct ReplacePart){ literalPart, (int32_t)(bytes - replace.bytes), (int32_t)(end - bytes) };
+	
+	return partCount;
+}
+
+static
+void appendReplace (struct Chars(Append) *chars, const struct ReplacePart *parts, int32_t partCount, struct Text replace, struct Text before, struct Text match, struct Text after, const char *capture[])
+{
+	int32_t index;
+	
+	for (index = 0; index < partCount; ++index)
+		switch (parts[index].kind)
+		{
+			case literalPart:
+				Chars.appendBytes(chars, replace.bytes + parts[index].offset, parts[index].length);
+				break;
+			
+			case matchPart:
+				Chars.appendBytes(chars, match.bytes, match.length);
+				break;
+			
+			case beforePart:
+				Chars.appendBytes(chars, before.bytes, before.length);
+				break;
+			
+			case afterPart:
+				Chars.appendBytes(chars, after.bytes, after.length);
+				break;
+			
+			default:
+				if (capture[parts[index].kind * 2])
+					Chars.appendBytes(chars, capture[parts[index].kind * 2], (int32_t)(capture[parts[index].kind * 2 + 1] - capture[parts[index].kind * 2]));
+		}
 }
 
 static
@@ -453,16 +566,28 @@ struct Value replace (struct Context * const context)
 	{
 		const char *capture[regexp->count * 2];
 		const char *index[regexp->count * 2];
-		struct Text seek = text;
+		const char *unitBytes = bytes;
+		struct Text seek = text, replaceText = Text(empty);
+		struct ReplacePart *parts = NULL;
+		int32_t partCount = 0, units = 0;
+		
+		// the replacement is parsed once rather than at every match
+		if (replace.type != Value(functionType))
+		{
+			replaceText = Value.textOf(&replace);
+			parts = createReplaceParts(replaceText);
+			partCount = compileReplace(replaceText, regexp->count, parts);
+		}
 		
 		Chars.beginAppend(&chars);
+		Chars.reserveAppend(&chars, length);
 		do
 		{
 			struct RegExp(State) state = { seek.bytes, text.bytes + text.length, capture, index };
 			
 			if (RegExp.matchWithState(regexp, &state))
 			{
-				Chars.append(&chars, "%.*s", capture[0] - text.bytes, text.bytes);
+				Chars.appendBytes(&chars, text.bytes, capture[0] - text.bytes);
 				
 				if (replace.type == Value(functionType))
 				{
@@ -477,19 +602,21 @@ struct Value replace (struct Context * const context)
 						else
 							arguments->element[index].value = Value(undefined);
 					}
-					arguments->element[regexp->count].value = Value.integer(String.unitIndex(bytes, length, (int32_t)(capture[0] - bytes)));
+					// the offset from the start is advanced from the previous match instead of recounted
+					units += unitCount(unitBytes, (int32_t)(capture[0] - unitBytes));
+					unitBytes = capture[0];
+					
+					arguments->element[regexp->count].value = Value.integer(units);
 					arguments->element[regexp->count + 1].value = context->this;
 					
 					result = Value.toString(context, Op.callFunctionArguments(context, 0, replace.data.function, Value(undefined), arguments));
-					Chars.append(&chars, "%.*s", Value.stringLength(&result), Value.stringBytes(&result));
+					Chars.appendBytes(&chars, Value.stringBytes(&result), Value.stringLength(&result));
 				}
 				else
-					replaceText(&chars,
-								Text.make(Value.stringBytes(&replace), Value.stringLength(&replace)),
+					appendReplace(&chars, parts, partCount, replaceText,
 								Text.make(bytes, (int32_t)(capture[0] - bytes)),
 								Text.make(capture[0], (int32_t)(capture[1] - capture[0])),
 								Text.make(capture[1], (int32_t)((bytes + length) - capture[1])),
-								regexp->count,
 								capture);
 				
 				Text.advance(&text, (int32_t)(state.capture[1] - text.bytes));
@@ -503,7 +630,8 @@ struct Value replace (struct Context * const context)
 		}
 		while (text.length && regexp->global);
 		
-		Chars.append(&chars, "%.*s", text.length, text.bytes);
+		free(parts), parts = NULL;
+		Chars.appendBytes(&chars, text.bytes, text.length);
 		
 		return Chars.endAppend(&chars);
 	}
@@ -512,21 +640,13 @@ struct Value replace (struct Context * const context)
 		searchBytes = Value.stringBytes(&value);
 		searchLength = Value.stringLength(&value);
 		
-		for (;;)
-		{
-			if (!text.length)
-				return context->this;
-			
-			if (!memcmp(text.bytes, searchBytes, searchLength))
-			{
-				text.length = searchLength;
-				break;
-			}
-			Text.nextCharacter(&text);
-		}
+		if (!text.length || !(searchBytes = Text.find(text, Text.make(searchBytes, searchLength))))
+			return context->this;
+		
+		text = Text.make(searchBytes, searchLength);
 		
 		Chars.beginAppend(&chars);
-		Chars.append(&chars, "%.*s", text.bytes - bytes, bytes);
+		Chars.appendBytes(&chars, bytes, text.bytes - bytes);
 		
 		if (replace.type == Value(functionType))
 		{
@@ -538,18 +658,23 @@ struct Value replace (struct Context * const context)
 			arguments->element[2].value = context->this;
 			
 			result = Value.toString(context, Op.callFunctionArguments(context, 0, replace.data.function, Value(undefined), arguments));
-			Chars.append(&chars, "%.*s", Value.stringLength(&result), Value.stringBytes(&result));
+			Chars.appendBytes(&chars, Value.stringBytes(&result), Value.stringLength(&result));
 		}
 		else
-			replaceText(&chars,
-						Text.make(Value.stringBytes(&replace), Value.stringLength(&replace)),
-						Text.make(text.bytes, (int32_t)(text.bytes - bytes)),
+		{
+			struct Text replaceText = Value.textOf(&replace);
+			struct ReplacePart *parts = createReplaceParts(replaceText);
+			
+			appendReplace(&chars, parts, compileReplace(replaceText, 0, parts), replaceText,
+						Text.make(bytes, (int32_t)(text.bytes - bytes)),
 						Text.make(text.bytes, text.length),
-						Text.make(text.bytes, (int32_t)(length - (text.bytes - bytes))),
-						0,
+						Text.make(text.bytes + text.length, (int32_t)(bytes + length - text.bytes - text.length)),
 						NULL);
+			
+			free(parts), parts = NULL;
+		}
 		
-		Chars.append(&chars, "%.*s", length - (text.bytes - bytes), text.bytes + text.length);
+		Chars.appendBytes(&chars, text.bytes + text.length, (int32_t)(bytes + length - text.bytes - text.length));
 		
 		return Chars.endAppend(&chars);
 	}
@@ -608,7 +733,7 @@ struct Value slice (struct Context * const context)
 	else if (from.type == Value(binaryType) && from.data.binary == INFINITY)
 		start = Text.make(chars + length, 0);
 	else
-		start = textAtIndex(chars, length, Value.toInteger(context, from).data.integer, 1);
+		start = textAtValueIndex(&context->this, Value.toInteger(context, from).data.integer, 1);
 	
 	to = Context.argument(context, 1);
 	if (to.type == Value(undefinedType) || (to.type == Value(binaryType) && (isnan(to.data.binary) || to.data.binary == INFINITY)))
@@ -616,7 +741,7 @@ struct Value slice (struct Context * const context)
 	else if (to.type == Value(binaryType) && to.data.binary == -INFINITY)
 		end = Text.make(chars, length);
 	else
-		end = textAtIndex(chars, length, Value.toInteger(context, to).data.integer, 1);
+		end = textAtValueIndex(&context->this, Value.toInteger(context, to).data.integer, 1);
 	
 	if (start.flags & Text(breakFlag))
 		headcp = Text.nextCharacter(&start).codepoint;
@@ -631,6 +756,8 @@ struct Value slice (struct Context * const context)
 	
 	if (head + length + tail <= 0)
 		return Value.text(&Text(empty));
+	else if (!head && !tail)
+		return sliceOf(&context->this, Text.make(start.bytes, length));
 	else
 	{
 		struct Chars *result = Chars.createSized(length + head + tail);
@@ -660,7 +787,6 @@ struct Value split (struct Context * const context)
 	struct Value separatorValue, limitValue;
 	struct RegExp *regexp = NULL;
 	struct Object *array;
-	struct Chars *element;
 	struct Text text, separator = { 0 };
 	uint32_t size = 0, limit = UINT32_MAX;
 	
@@ -714,12 +840,11 @@ struct Value split (struct Context * const context)
 			{
 				if (capture[1] <= text.bytes)
 				{
-					Text.advance(&seek, 1);
+					Text.nextCharacter(&seek);
 					continue;
 				}
 				
-				element = Chars.createWithBytes((int32_t)(capture[0] - text.bytes), text.bytes);
-				Object.addElement(array, size++, Value.chars(element), 0);
+				Object.addElement(array, size++, sliceOf(&context->this, Text.make(text.bytes, (int32_t)(capture[0] - text.bytes))), 0);
 				
 				for (index = 1, count = regexp->count; index < count; ++index)
 				{
@@ -728,8 +853,7 @@ struct Value split (struct Context * const context)
 					
 					if (capture[index * 2])
 					{
-						element = Chars.createWithBytes((int32_t)(capture[index * 2 + 1] - capture[index * 2]), capture[index * 2]);
-						Object.addElement(array, size++, Value.chars(element), 0);
+						Object.addElement(array, size++, sliceOf(&context->this, Text.make(capture[index * 2], (int32_t)(capture[index * 2 + 1] - capture[index * 2]))), 0);
 					}
 					else
 						Object.addElement(array, size++, Value(undefined), 0);
@@ -740,8 +864,7 @@ struct Value split (struct Context * const context)
 			}
 			else
 			{
-				element = Chars.createWithBytes(text.length, text.bytes);
-				Object.addElement(array, size++, Value.chars(element), 0);
+				Object.addElement(array, size++, sliceOf(&context->this, text), 0);
 				break;
 			}
 		}
@@ -778,34 +901,18 @@ struct Value split (struct Context * const context)
 	}
 	else
 	{
-		struct Text seek = text;
+		const char *found;
 		int32_t length;
 		
-		while (seek.length >= separator.length)
+		while (size < limit && (found = Text.find(text, separator)))
 		{
-			if (size >= limit)
-				break;
-			
-			if (!memcmp(seek.bytes, separator.bytes, separator.length))
-			{
-				length = (int32_t)(seek.bytes - text.bytes);
-				element = Chars.createSized(length);
-				memcpy(element->bytes, text.bytes, length);
-				Object.addElement(array, size++, Value.chars(element), 0);
-				
-				Text.advance(&text, length + separator.length);
-				seek = text;
-				continue;
-			}
-			Text.nextCharacter(&seek);
+			length = (int32_t)(found - text.bytes);
+			Object.addElement(array, size++, sliceOf(&context->this, Text.make(text.bytes, length)), 0);
+			Text.advance(&text, length + separator.length);
 		}
 		
 		if (size < limit)
-		{
-			element = Chars.createSized(text.length);
-			memcpy(element->bytes, text.bytes, text.length);
-			Object.addElement(array, size++, Value.chars(element), 0);
-		}
+			Object.addElement(array, size++, sliceOf(&context->this, text), 0);
 	}
 	
 	return Value.object(array);
@@ -830,7 +937,7 @@ struct Value substring (struct Context * const context)
 	else if (from.type == Value(binaryType) && from.data.binary == INFINITY)
 		start = Text.make(chars + length, 0);
 	else
-		start = textAtIndex(chars, length, Value.toInteger(context, from).data.integer, 0);
+		start = textAtValueIndex(&context->this, Value.toInteger(context, from).data.integer, 0);
 	
 	to = Context.argument(context, 1);
 	if (to.type == Value(undefinedType) || (to.type == Value(binaryType) && to.data.binary == INFINITY))
@@ -838,7 +945,7 @@ struct Value substring (struct Context * const context)
 	else if (to.type == Value(binaryType) && !isfinite(to.data.binary))
 		end = Text.make(chars, length);
 	else
-		end = textAtIndex(chars, length, Value.toInteger(context, to).data.integer, 0);
+		end = textAtValueIndex(&context->this, Value.toInteger(context, to).data.integer, 0);
 	
 	if (start.bytes > end.bytes)
 	{
@@ -860,6 +967,8 @@ struct Value substring (struct Context * const context)
 	
 	if (head + length + tail <= 0)
 		return Value.text(&Text(empty));
+	else if (!head && !tail)
+		return sliceOf(&context->this, Text.make(start.bytes, length));
 	else
 	{
 		struct Chars *result = Chars.createSized(length + head + tail);
@@ -922,7 +1031,6 @@ struct Value toUpperCase (struct Context * const context)
 static
 struct Value trim (struct Context * const context)
 {
-	struct Chars *chars;
 	struct Text text, last;
 	struct Text(Char) c;
 	
@@ -930,8 +1038,19 @@ struct Value trim (struct Context * const context)
 		context->this = Value.toString(context, Context.this(context));
 	
 	text = Value.textOf(&context->this);
+	
+	// ASCII bytes are tested as they are, only other characters are decoded
 	while (text.length)
 	{
+		if (!(*text.bytes & 0x80))
+		{
+			if (!isspace(*text.bytes))
+				break;
+			
+			Text.advance(&text, 1);
+			continue;
+		}
+		
 		c = Text.character(text);
 		if (!Text.isSpace(c))
 			break;
@@ -942,6 +1061,16 @@ struct Value trim (struct Context * const context)
 	last = Text.make(text.bytes + text.length, text.length);
 	while (last.length)
 	{
+		if (!(last.bytes[-1] & 0x80))
+		{
+			if (!isspace(last.bytes[-1]))
+				break;
+			
+			--last.bytes;
+			text.length = --last.length;
+			continue;
+		}
+		
 		c = Text.prevCharacter(&last);
 		if (!Text.isSpace(c))
 			break;
@@ -949,9 +1078,7 @@ struct Value trim (struct Context * const context)
 		text.length = last.length;
 	}
 	
-	chars = Chars.createWithBytes(text.length, text.bytes);
-	
-	return Value.chars(chars);
+	return sliceOf(&context->this, text);
 }
 
 static
@@ -1040,12 +1167,16 @@ struct String * create (struct Chars *chars)
 	
 	Object.initialize(&self->object, String(prototype));
 	
-	length = unitIndex(chars->bytes, chars->length, chars->length);
+	chars = Chars.flatten(chars);
+	if (chars->referenceCount >= INT16_MAX - 1)
+		chars = Chars.createWithBytes(chars->length, Chars.bytesOf(chars));
+	
+	length = Chars.unitLength(chars);
 	Object.addMember(&self->object, Key(length), Value.integer(length), r|h|s);
 	
+	// primitives are boxed without copying, so the string holds a reference from the start
 	self->value = chars;
-	if (length == chars->length)
-		chars->flags |= Chars(asciiOnly);
+	++chars->referenceCount;
 	
 	return self;
 }
@@ -1055,7 +1186,7 @@ struct Value valueAtIndex (struct String *self, int32_t index)
 	struct Text(Char) c;
 	struct Text text;
 	
-	text = textAtIndex(self->value->bytes, self->value->length, index, 0);
+	text = textAtCharsIndex(self->value, index, 0);
 	c = Text.character(text);
 	
 	if (c.units <= 0)
@@ -1082,26 +1213,24 @@ struct Value valueAtIndex (struct String *self, int32_t index)
 	}
 }
 
+struct Value sliceOf (const struct Value *value, struct Text text)
+{
+	struct Chars *chars = indexedCharsOf(value);
+	
+	// text lies within the bytes of value, which long slices keep referencing
+	if (chars)
+		return Value.chars(Chars.createView(chars, (int32_t)(text.bytes - Chars.bytesOf(chars)), text.length));
+	else
+		return Value.chars(Chars.createWithBytes(text.length, text.bytes));
+}
+
 struct Text textAtIndex (const char *chars, int32_t length, int32_t position, int enableReverse)
 {
-	struct Text text = Text.make(chars, length), prev;
+	struct Text text = Text.make(chars, length);
 	struct Text(Char) c;
 	
 	if (position >= 0)
-	{
-		while (position-- > 0)
-		{
-			prev = text;
-			c = Text.nextCharacter(&text);
-			
-			if (c.codepoint > 0xffff && !position--)
-			{
-				/* simulate 16-bit surrogate */
-				text = prev;
-				text.flags = Text(breakFlag);
-			}
-		}
-	}
+		text = walkToIndex(text, position);
 	else if (enableReverse)
 	{
 		text.bytes += length;
@@ -1127,22 +1256,5 @@ struct Text textAtIndex (const char *chars, int32_t length, int32_t position, in
 
 int32_t unitIndex (const char *chars, int32_t max, int32_t unit)
 {
-	struct Text text = Text.make(chars, max);
-	int32_t position = 0;
-	struct Text(Char) c;
-	
-	while (unit > 0)
-	{
-		if (text.length)
-		{
-			++position;
-			c = Text.nextCharacter(&text);
-			unit -= c.units;
-			
-			if (c.codepoint > 0xffff) /* simulate 16-bit surrogate */
-				++position;
-		}
-	}
-	
-	return position;
+	return unitCount(chars, unit < max? unit: max);
 }
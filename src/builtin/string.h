@@ -17,8 +17,8 @@
 
 	#include "global.h"
 
-	extern struct Object * String(prototype);
-	extern struct Function * String(constructor);
+	extern Ecc(threadLocal) struct Object * String(prototype);
+	extern Ecc(threadLocal) struct Function * String(constructor);
 	extern const struct Object(Type) String(type);
 
 #endif
@@ -31,6 +31,7 @@ Interface(String,
 	
 	(struct String *, create ,(struct Chars *))
 	(struct Value, valueAtIndex ,(struct String *, int32_t index))
+	(struct Value, sliceOf ,(const struct Value *, struct Text text))
 	
 	(struct Text, textAtIndex ,(const char *chars, int32_t length, int32_t index, int enableReverse))
 	(int32_t, unitIndex ,(const char *chars, int32_t max, int32_t unit))
@@ -0,0 +1,863 @@
+//
+//  bytecode.c
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#define Implementation
+#include "bytecode.h"
+
+#include "oplist.h"
+
+// MARK: - Private
+
+enum {
+	format = 1,
+};
+
+enum Tag {
+	primitiveTag,
+	keyTag,
+	charsTag,
+	functionTag,
+	selfTag,
+	outerSlotTag,
+};
+
+enum {
+	textNull = -1,
+	textEmpty = -2,
+};
+
+struct Writer {
+	char *bytes;
+	uint32_t length;
+	uint32_t capacity;
+	
+	const Native(Function) *natives;
+	uint16_t nativeCount;
+	
+	struct Input *input;
+	struct Object *environment;
+	
+	uint16_t *keyIndices;
+	struct Key *keys;
+	uint32_t keyCount;
+	
+	int error;
+};
+
+struct Reader {
+	const char *bytes;
+	uint32_t length;
+	uint32_t offset;
+	
+	const Native(Function) *natives;
+	uint16_t nativeCount;
+	
+	struct Input *input;
+	struct Object *environment;
+	
+	struct Key *keys;
+	uint32_t keyCount;
+	
+	int error;
+};
+
+static const char magic[4] = { 'e', 'c', 'b', '\0' };
+
+#define _(X) #X ","
+static const char opNames[] = io_libecc_op_List;
+#undef _
+
+// MARK: - Static Members
+
+static
+uint64_t hashBytes (uint64_t hash, const char *bytes, uint32_t length)
+{
+	while (length--)
+		hash = (hash ^ (uint8_t)*bytes++) * UINT64_C(0x100000001b3);
+	
+	return hash;
+}
+
+static
+uint64_t hashInput (struct Input *input)
+{
+	uint64_t hash = UINT64_C(0xcbf29ce484222325);
+	
+	hash = hashBytes(hash, opNames, sizeof(opNames) - 1);
+	hash = hashBytes(hash, input->bytes, input->length);
+	
+	return hash;
+}
+
+static
+uint32_t flagsOf (struct Parser *parser)
+{
+	return (parser->strictMode? Bytecode(strictMode): 0)
+		| (parser->lexer->allowUnicodeOutsideLiteral? Bytecode(sloppyMode): 0)
+		;
+}
+
+static
+int isLocalSlot (const Native(Function) native)
+{
+	return native == Op.getLocalSlotRef
+		|| native == Op.getLocalSlot
+		|| native == Op.setLocalSlot
+		|| native == Op.deleteLocalSlot
+		;
+}
+
+static
+int isParentSlot (const Native(Function) native)
+{
+	return native == Op.getParentSlotRef
+		|| native == Op.getParentSlot
+		|| native == Op.setParentSlot
+		|| native == Op.deleteParentSlot
+		;
+}
+
+static
+struct Value * ownMember (struct Object *object, struct Key key)
+{
+	struct Value *ref = Object.member(object, key, Value(asOwn));
+	
+	if (ref && (union Object(Hashmap) *)ref >= object->hashmap && (union Object(Hashmap) *)ref < object->hashmap + object->hashmapCount)
+		return ref;
+	
+	return NULL;
+}
+
+// MARK: Write
+
+static
+void writeBytes (struct Writer *self, const void *bytes, uint32_t length)
+{
+	if (self->length + length > self->capacity)
+	{
+		self->capacity = (self->length + length) * 2;
+		self->bytes = realloc(self->bytes, self->capacity);
+	}
+	memcpy(self->bytes + self->length, bytes, length);
+	self->length += length;
+}
+
+static
+void writeUint8 (struct Writer *self, uint8_t value)
+{
+	writeBytes(self, &value, sizeof(value));
+}
+
+static
+void writeUint16 (struct Writer *self, uint16_t value)
+{
+	writeBytes(self, &value, sizeof(value));
+}
+
+static
+void writeUint32 (struct Writer *self, uint32_t value)
+{
+	writeBytes(self, &value, sizeof(value));
+}
+
+static
+void writeKey (struct Writer *self, struct Key key)
+{
+	uint16_t number = key.data.depth[0] << 12 | key.data.depth[1] << 8 | key.data.depth[2] << 4 | key.data.depth[3];
+	
+	if (number && !self->keyIndices[number])
+	{
+		self->keys = realloc(self->keys, sizeof(*self->keys) * (self->keyCount + 1));
+		self->keys[self->keyCount++] = key;
+		self->keyIndices[number] = self->keyCount;
+	}
+	writeUint16(self, number? self->keyIndices[number]: 0);
+}
+
+static
+void writeText (struct Writer *self, struct Text text)
+{
+	int32_t offset;
+	
+	if (text.bytes >= self->input->bytes && text.bytes + text.length <= self->input->bytes + self->input->length)
+		offset = (int32_t)(text.bytes - self->input->bytes);
+	else if (!text.bytes && !text.length)
+		offset = textNull;
+	else if (text.bytes == Text(empty).bytes)
+		/* OpList.text of a list starting with an empty text keeps a length */
+		offset = textEmpty;
+	else
+	{
+		offset = textNull;
+		self->error = 1;
+	}
+	
+	writeUint32(self, offset);
+	writeUint32(self, text.length);
+	writeUint8(self, text.flags);
+}
+
+static
+void writeNative (struct Writer *self, const Native(Function) native)
+{
+	uint16_t index;
+	
+	for (index = 0; index < self->nativeCount; ++index)
+		if (self->natives[index] == native)
+			break;
+	
+	if (index == self->nativeCount)
+		self->error = 1;
+	
+	writeUint16(self, index);
+}
+
+static
+void writeValueHeader (struct Writer *self, enum Tag tag, struct Value value)
+{
+	writeUint8(self, tag);
+	writeKey(self, value.key);
+	writeUint8(self, value.flags);
+	writeUint16(self, value.check);
+}
+
+static void writeFunction (struct Writer *self, struct Function *function, uint32_t depth);
+
+static
+void writeValue (struct Writer *self, struct Value value, struct Function *function, uint32_t depth)
+{
+	switch ((enum Value(Type))value.type)
+	{
+		case Value(undefinedType):
+		case Value(nullType):
+		case Value(falseType):
+		case Value(trueType):
+			writeValueHeader(self, primitiveTag, value);
+			writeUint8(self, value.type);
+			return;
+		
+		case Value(integerType):
+			writeValueHeader(self, primitiveTag, value);
+			writeUint8(self, value.type);
+			writeUint32(self, value.data.integer);
+			return;
+		
+		case Value(binaryType):
+			writeValueHeader(self, primitiveTag, value);
+			writeUint8(self, value.type);
+			writeBytes(self, &value.data.binary, sizeof(value.data.binary));
+			return;
+		
+		case Value(bufferType):
+			writeValueHeader(self, primitiveTag, value);
+			writeUint8(self, value.type);
+			writeBytes(self, value.data.buffer, sizeof(value.data.buffer));
+			return;
+		
+		case Value(keyType):
+			writeValueHeader(self, keyTag, value);
+			writeKey(self, value.data.key);
+			return;
+		
+		case Value(charsType):
+			writeValueHeader(self, charsTag, value);
+			writeUint32(self, value.data.chars->length);
+			writeBytes(self, Chars.bytesOf(value.data.chars), value.data.chars->length);
+			return;
+		
+		case Value(functionType):
+			if (value.data.function == function)
+			{
+				writeValueHeader(self, selfTag, value);
+				return;
+			}
+			else if (!(value.data.function->flags & Function(isNative)) && value.data.function->oplist)
+			{
+				writeValueHeader(self, functionTag, value);
+				writeFunction(self, value.data.function, depth + 1);
+				return;
+			}
+			break;
+		
+		default:
+			break;
+	}
+	
+	writeValueHeader(self, primitiveTag, Value(undefined));
+	writeUint8(self, Value(undefinedType));
+	self->error = 1;
+}
+
+static
+void writeOps (struct Writer *self, struct Function *function, uint32_t depth)
+{
+	struct OpList *oplist = function->oplist;
+	int32_t index, environmentLevel = 0;
+	
+	writeUint32(self, oplist->count);
+	
+	for (index = 0; index < oplist->count; ++index)
+	{
+		struct Op op = oplist->ops[index];
+		
+		writeNative(self, op.native);
+		writeText(self, op.text);
+		
+		if (op.native == Op.pushEnvironment)
+			++environmentLevel;
+		else if (op.native == Op.popEnvironment)
+			--environmentLevel;
+		
+		if (isParentSlot(op.native) && (op.value.data.integer >> 16) - environmentLevel > (int32_t)depth)
+		{
+			/* slots outside the compiled tree depend on the host's global layout: store them by key */
+			int32_t level = op.value.data.integer >> 16, slot = op.value.data.integer & 0xffff;
+			int32_t hops = level - environmentLevel - depth - 1, count = hops;
+			struct Object *object = self->environment;
+			
+			while (object && count--)
+				object = object->prototype;
+			
+			writeValueHeader(self, outerSlotTag, op.value);
+			writeUint16(self, level);
+			writeUint16(self, hops);
+			
+			if (object && slot < object->hashmapCount && object->hashmap[slot].value.check == 1)
+				writeKey(self, object->hashmap[slot].value.key);
+			else
+			{
+				writeKey(self, Key(none));
+				self->error = 1;
+			}
+		}
+		else
+			writeValue(self, op.value, function, depth);
+	}
+}
+
+static
+void writeFunction (struct Writer *self, struct Function *function, uint32_t depth)
+{
+	struct Object *environment = &function->environment;
+	uint32_t index, count = 0;
+	
+	writeUint32(self, function->flags);
+	writeUint32(self, function->parameterCount);
+	writeText(self, function->text);
+	
+	while (2 + count < environment->hashmapCount && environment->hashmap[2 + count].value.check == 1)
+		++count;
+	
+	for (index = 2 + count; index < environment->hashmapCount; ++index)
+		if (environment->hashmap[index].value.check == 1)
+			self->error = 1;
+	
+	writeUint8(self, environment->hashmapCount == 2 + count);
+	writeUint32(self, count);
+	for (index = 0; index < count; ++index)
+		writeValue(self, environment->hashmap[2 + index].value, function, depth);
+	
+	writeOps(self, function, depth);
+}
+
+// MARK: Read
+
+static
+const char * readBytes (struct Reader *self, uint32_t length)
+{
+	const char *bytes = self->bytes + self->offset;
+	
+	if (self->error || length > self->length - self->offset)
+	{
+		self->error = 1;
+		return NULL;
+	}
+	
+	self->offset += length;
+	return bytes;
+}
+
+static
+uint8_t readUint8 (struct Reader *self)
+{
+	uint8_t value = 0;
+	const char *bytes = readBytes(self, sizeof(value));
+	if (bytes)
+		memcpy(&value, bytes, sizeof(value));
+	
+	return value;
+}
+
+static
+uint16_t readUint16 (struct Reader *self)
+{
+	uint16_t value = 0;
+	const char *bytes = readBytes(self, sizeof(value));
+	if (bytes)
+		memcpy(&value, bytes, sizeof(value));
+	
+	return value;
+}
+
+static
+uint32_t readUint32 (struct Reader *self)
+{
+	uint32_t value = 0;
+	const char *bytes = readBytes(self, sizeof(value));
+	if (bytes)
+		memcpy(&value, bytes, sizeof(value));
+	
+	return value;
+}
+
+static
+struct Key readKey (struct Reader *self)
+{
+	uint16_t index = readUint16(self);
+	
+	if (!index)
+		return Key(none);
+	else if (index > self->keyCount)
+	{
+		self->error = 1;
+		return Key(none);
+	}
+	
+	return self->keys[index - 1];
+}
+
+static
+struct Text readText (struct Reader *self)
+{
+	int32_t offset = readUint32(self);
+	uint32_t length = readUint32(self);
+	struct Text text = Text(empty);
+	
+	if (offset == textNull && !length)
+		text = Text.make(NULL, 0);
+	else if (offset == textEmpty)
+		text = Text.make(Text(empty).bytes, length);
+	else if (offset < 0 || (uint32_t)offset > self->input->length || length > self->input->length - offset)
+		self->error = 1;
+	else
+		text = Text.make(self->input->bytes + offset, length);
+	
+	text.flags = readUint8(self);
+	return text;
+}
+
+static
+struct Value readOuterSlot (struct Reader *self, struct Value value)
+{
+	uint16_t level = readUint16(self), hops = readUint16(self);
+	struct Key key = readKey(self);
+	struct Object *object = self->environment;
+	struct Value *ref = NULL;
+	uint32_t slot;
+	
+	if (!key.data.integer || level > INT16_MAX)
+	{
+		self->error = 1;
+		return value;
+	}
+	
+	/* the same lookup as OpList.optimizeWithEnvironment; a nearer match means the host changed */
+	while (object)
+	{
+		ref = ownMember(object, key);
+		if (!hops--)
+			break;
+		else if (ref)
+			object = NULL;
+		else
+			object = object->prototype;
+	}
+	
+	if (!object || !ref || (slot = (uint32_t)((union Object(Hashmap) *)ref - object->hashmap)) > INT16_MAX)
+	{
+		self->error = 1;
+		return value;
+	}
+	
+	value.data.integer = level << 16 | slot;
+	return value;
+}
+
+static struct Function * readFunction (struct Reader *self, struct Object *environment, uint32_t depth);
+
+static
+struct Value readValue (struct Reader *self, struct Function *function, uint32_t depth)
+{
+	struct Value value = Value(undefined);
+	enum Tag tag = readUint8(self);
+	struct Key key = readKey(self);
+	uint8_t flags = readUint8(self);
+	uint16_t check = readUint16(self);
+	
+	switch (tag)
+	{
+		case primitiveTag:
+			value.type = readUint8(self);
+			switch ((enum Value(Type))value.type)
+			{
+				case Value(undefinedType):
+				case Value(nullType):
+				case Value(falseType):
+				case Value(trueType):
+					break;
+				
+				case Value(integerType):
+					value.data.integer = readUint32(self);
+					break;
+				
+				case Value(binaryType):
+				case Value(bufferType):
+				{
+					const char *bytes = readBytes(self, sizeof(value.data));
+					if (bytes)
+						memcpy(&value.data, bytes, sizeof(value.data));
+					
+					break;
+				}
+				
+				default:
+					self->error = 1;
+					break;
+			}
+			break;
+		
+		case keyTag:
+			value = Value.key(readKey(self));
+			break;
+		
+		case charsTag:
+		{
+			uint32_t length = readUint32(self);
+			const char *bytes = readBytes(self, length);
+			if (bytes)
+				value = Input.attachValue(self->input, Value.chars(Chars.createWithBytes(length, bytes)));
+			
+			break;
+		}
+		
+		case functionTag:
+		{
+			struct Function *child = readFunction(self, &function->environment, depth + 1);
+			if (child)
+				value = Value.function(child);
+			
+			break;
+		}
+		
+		case selfTag:
+			value = Value.function(function);
+			break;
+		
+		case outerSlotTag:
+			value = readOuterSlot(self, Value.integer(0));
+			break;
+		
+		default:
+			self->error = 1;
+			break;
+	}
+	
+	value.key = key;
+	value.flags = flags;
+	value.check = check;
+	return value;
+}
+
+static
+struct OpList * readOps (struct Reader *self, struct Function *function, uint32_t depth)
+{
+	struct OpList *oplist;
+	uint32_t index, count = readUint32(self);
+	int32_t environmentLevel = 0;
+	
+	if (!count || count > (self->length - self->offset) / 8)
+	{
+		self->error = 1;
+		return NULL;
+	}
+	
+	oplist = malloc(sizeof(*oplist));
+	oplist->ops = malloc(sizeof(*oplist->ops) * count);
+	oplist->count = count;
+	
+	for (index = 0; index < count; ++index)
+	{
+		struct Op *op = oplist->ops + index;
+		uint16_t native = readUint16(self);
+		
+		op->native = native < self->nativeCount? self->natives[native]: Op.noop;
+		op->text = readText(self);
+		op->value = readValue(self, function, depth);
+		
+		if (native >= self->nativeCount)
+			self->error = 1;
+		else if (op->native == Op.pushEnvironment)
+			++environmentLevel;
+		else if (op->native == Op.popEnvironment)
+			--environmentLevel;
+		else if (isLocalSlot(op->native))
+		{
+			if ((uint32_t)op->value.data.integer >= function->environment.hashmapCount)
+				self->error = 1;
+		}
+		else if (isParentSlot(op->native))
+		{
+			int32_t hops = (op->value.data.integer >> 16) - environmentLevel;
+			uint32_t slot = op->value.data.integer & 0xffff;
+			struct Object *object = &function->environment;
+			
+			if (hops < 0)
+				self->error = 1;
+			else if (hops <= (int32_t)depth)
+			{
+				while (hops--)
+					object = object->prototype;
+				
+				if (slot >= object->hashmapCount || object->hashmap[slot].value.check != 1)
+					self->error = 1;
+			}
+		}
+		
+		if (self->error)
+		{
+			oplist->count = index + 1;
+			break;
+		}
+	}
+	
+	return oplist;
+}
+
+static
+struct Function * readFunction (struct Reader *self, struct Object *environment, uint32_t depth)
+{
+	struct Function *function;
+	uint32_t index, count;
+	int stripped;
+	
+	if (self->error)
+		return NULL;
+	
+	function = Function.create(environment);
+	function->flags = readUint32(self);
+	function->parameterCount = readUint32(self);
+	function->text = readText(self);
+	
+	stripped = readUint8(self);
+	count = readUint32(self);
+	
+	for (index = 0; index < count && !self->error; ++index)
+	{
+		struct Value value = readValue(self, function, depth);
+		
+		if (value.key.data.integer)
+			Object.addMember(&function->environment, value.key, value, 0);
+		else
+		{
+			/* unreachable slot left by a duplicate parameter */
+			Object.reserveSlots(&function->environment, 1);
+			function->environment.hashmap[function->environment.hashmapCount++].value = value;
+		}
+	}
+	
+	Object.packValue(&function->environment);
+	if (stripped)
+		Object.stripMap(&function->environment);
+	
+	if (function->environment.hashmapCount < 2 + count || (count && function->environment.hashmap[1 + count].value.check != 1))
+		self->error = 1;
+	
+	if (function->parameterCount < 0 || (function->parameterCount && 3 + function->parameterCount > 2 + count))
+		self->error = 1;
+	
+	if (depth)
+		Object.addMember(&function->object, Key(length), Value.integer(function->parameterCount), Value(readonly) | Value(hidden) | Value(sealed));
+	
+	if (!self->error)
+		function->oplist = readOps(self, function, depth);
+	
+	return self->error? NULL: function;
+}
+
+// MARK: - Methods
+
+int writeFile (struct Parser * const parser, struct Function *function, const char *filename)
+{
+	#define _(X) Op.X,
+	const Native(Function) natives[] = { io_libecc_op_List };
+	#undef _
+	
+	struct Text inputError = Text(inputErrorName);
+	struct Input *input = parser->lexer->input;
+	struct Writer head = { 0 }, body = {
+		.natives = natives,
+		.nativeCount = sizeof(natives) / sizeof(*natives),
+		.input = input,
+		.environment = function->environment.prototype,
+	};
+	struct Bytecode header = {
+		.format = format,
+		.flags = flagsOf(parser),
+		.hash = hashInput(input),
+	};
+	uint32_t index;
+	FILE *file;
+	int result = 0;
+	
+	assert(parser);
+	assert(function);
+	assert(filename);
+	
+	body.keyIndices = calloc(UINT16_MAX + 1, sizeof(*body.keyIndices));
+	
+	writeUint32(&body, parser->globalCount);
+	for (index = 0; index < parser->globalCount; ++index)
+	{
+		writeKey(&body, parser->globals[index].key);
+		writeUint8(&body, parser->globals[index].flags);
+	}
+	writeUint32(&body, parser->reserveGlobalSlots);
+	writeFunction(&body, function, 0);
+	
+	writeUint32(&head, input->lineCount);
+	writeBytes(&head, input->lines, sizeof(*input->lines) * (input->lineCount + 1));
+	
+	writeUint32(&head, body.keyCount);
+	for (index = 0; index < body.keyCount; ++index)
+	{
+		const struct Text *text = Key.textOf(body.keys[index]);
+		writeUint32(&head, text->length);
+		writeBytes(&head, text->bytes, text->length);
+	}
+	
+	memcpy(header.magic, magic, sizeof(header.magic));
+	header.size = sizeof(header) + head.length + body.length;
+	
+	if (parser->error || body.error)
+		Env.printError(inputError.length, inputError.bytes, "cannot compile '%s'", input->name);
+	else if (!(file = fopen(filename, "wb")))
+		Env.printError(inputError.length, inputError.bytes, "cannot open file '%s'", filename);
+	else
+	{
+		result = fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(head.bytes, 1, head.length, file) == head.length
+			&& fwrite(body.bytes, 1, body.length, file) == body.length;
+		
+		if (fclose(file) || !result)
+		{
+			Env.printError(inputError.length, inputError.bytes, "cannot write file '%s'", filename);
+			result = 0;
+		}
+	}
+	
+	free(head.bytes), head.bytes = NULL;
+	free(body.bytes), body.bytes = NULL;
+	free(body.keys), body.keys = NULL;
+	free(body.keyIndices), body.keyIndices = NULL;
+	
+	return result;
+}
+
+struct Function * readWithEnvironment (struct Parser * const parser, struct Object *environment, struct Object *global)
+{
+	#define _(X) Op.X,
+	const Native(Function) natives[] = { io_libecc_op_List };
+	#undef _
+	
+	struct Input *input = parser->lexer->input;
+	const struct Bytecode *bytecode = input->bytecode;
+	struct Reader reader = {
+		.natives = natives,
+		.nativeCount = sizeof(natives) / sizeof(*natives),
+		.input = input,
+		.environment = environment,
+	};
+	struct Function *function = NULL;
+	const char *lines;
+	uint32_t index, count, lineCount;
+	
+	assert(parser);
+	
+	if (!bytecode || bytecode->flags != flagsOf(parser))
+		return NULL;
+	
+	reader.bytes = (const char *)bytecode + sizeof(*bytecode);
+	reader.length = bytecode->size - sizeof(*bytecode);
+	
+	lineCount = readUint32(&reader);
+	if (lineCount >= UINT16_MAX)
+		return NULL;
+	
+	lines = readBytes(&reader, sizeof(*input->lines) * (lineCount + 1));
+	
+	count = readUint32(&reader);
+	if (count > UINT16_MAX)
+		return NULL;
+	
+	reader.keys = malloc(sizeof(*reader.keys) * (count + 1));
+	for (index = 0; index < count && !reader.error; ++index)
+	{
+		uint32_t length = readUint32(&reader);
+		const char *bytes = readBytes(&reader, length);
+		if (bytes)
+			reader.keys[reader.keyCount++] = Key.makeWithText(Text.make(bytes, length), Key(copyOnCreate));
+	}
+	
+	count = readUint32(&reader);
+	for (index = 0; index < count && !reader.error; ++index)
+	{
+		struct Key key = readKey(&reader);
+		uint8_t flags = readUint8(&reader);
+		
+		if (key.data.integer)
+			Object.addMember(global, key, Value(undefined), flags);
+		else
+			reader.error = 1;
+	}
+	
+	count = readUint32(&reader);
+	if (count < global->hashmapCapacity)
+		Object.reserveSlots(global, count);
+	
+	function = readFunction(&reader, environment, 0);
+	
+	if (reader.error || reader.offset != reader.length)
+		function = NULL;
+	else
+	{
+		if (input->lineCapacity <= lineCount)
+		{
+			input->lineCapacity = lineCount + 1;
+			input->lines = realloc(input->lines, sizeof(*input->lines) * input->lineCapacity);
+		}
+		memcpy(input->lines, lines, sizeof(*input->lines) * (lineCount + 1));
+		input->lineCount = lineCount;
+	}
+	
+	free(reader.keys), reader.keys = NULL;
+	
+	return function;
+}
+
+int isValid (const struct Bytecode *self, uint32_t size, struct Input *input)
+{
+	assert(input);
+	
+	return self
+		&& size >= sizeof(*self)
+		&& !memcmp(self->magic, magic, sizeof(self->magic))
+		&& self->format == format
+		&& self->size == size
+		&& self->hash == hashInput(input)
+		;
+}
@@ -0,0 +1,44 @@
+//
+//  bytecode.h
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#ifndef io_libecc_bytecode_h
+#ifdef Implementation
+#undef Implementation
+#include __FILE__
+#include "implementation.h"
+#else
+#include "interface.h"
+#define io_libecc_bytecode_h
+
+	#include "parser.h"
+	
+	enum Bytecode(Flags) {
+		Bytecode(strictMode) = 1 << 0,
+		Bytecode(sloppyMode) = 1 << 1,
+	};
+
+#endif
+
+
+Interface(Bytecode,
+	
+	(int, writeFile ,(struct Parser * const, struct Function *, const char *filename))
+	(struct Function *, readWithEnvironment ,(struct Parser * const, struct Object *environment, struct Object *global))
+	
+	(int, isValid ,(const struct Bytecode *, uint32_t size, struct Input *))
+	,
+	{
+		char magic[4];
+		uint32_t format;
+		uint32_t size;
+		uint32_t flags;
+		uint64_t hash;
+	}
+)
+
+#endif
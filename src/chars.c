@@ -41,21 +41,18 @@ uint32_t sizeForLength(uint32_t length)
 static
 struct Chars *reuseOrCreate (struct Chars(Append) *chars, uint32_t length)
 {
-	struct Chars *self = NULL, *reuse = chars? chars->value: NULL;
+	struct Chars *self, *reuse = chars->value;
+	uint32_t size;
 	
-	if (reuse && sizeForLength(reuse->length) >= sizeForLength(length))
+	if (reuse && length <= (uint32_t)chars->capacity)
 		return reuse;
-//	else
-//		chars = Pool.reusableChars(length);
+	else if (!reuse && length < 8)
+		return NULL;
 	
-	if (!self)
-	{
-		if (length < 8)
-			return NULL;
-		
-		self = malloc(sizeForLength(length));
-		Pool.addChars(self);
-	}
+	// capacity doubles, so a builder copies each byte about twice at most
+	size = sizeForLength(length);
+	self = malloc(size);
+	Pool.addChars(self);
 	
 	if (reuse)
 		memcpy(self, reuse, sizeof(*self) + reuse->length);
@@ -67,6 +64,409 @@ struct Chars *reuseOrCreate (struct Chars(Append) *chars, uint32_t length)
 	}
 	
 	chars->value = self;
+	chars->capacity = size - sizeof(*self);
+	return self;
+}
+
+/* shortest digits of a positive double: Grisu3 (Loitsch, 2010), or printf for the rare cases it cannot decide */
+
+struct Float {
+	uint64_t f;
+	int e;
+};
+
+static const struct {
+	uint64_t f;
+	int16_t e;
+	int16_t k;
+} cachedPowers[] = {
+	{ UINT64_C(0xfa8fd5a0081c0288), -1220, -348 },
+	{ UINT64_C(0xbaaee17fa23ebf76), -1193, -340 },
+	{ UINT64_C(0x8b16fb203055ac76), -1166, -332 },
+	{ UINT64_C(0xcf42894a5dce35ea), -1140, -324 },
+	{ UINT64_C(0x9a6bb0aa55653b2d), -1113, -316 },
+	{ UINT64_C(0xe61acf033d1a45df), -1087, -308 },
+	{ UINT64_C(0xab70fe17c79ac6ca), -1060, -300 },
+	{ UINT64_C(0xff77b1fcbebcdc4f), -1034, -292 },
+	{ UINT64_C(0xbe5691ef416bd60c), -1007, -284 },
+	{ UINT64_C(0x8dd01fad907ffc3c), -980, -276 },
+	{ UINT64_C(0xd3515c2831559a83), -954, -268 },
+	{ UINT64_C(0x9d71ac8fada6c9b5), -927, -260 },
+	{ UINT64_C(0xea9c227723ee8bcb), -901, -252 },
+	{ UINT64_C(0xaecc49914078536d), -874, -244 },
+	{ UINT64_C(0x823c12795db6ce57), -847, -236 },
+	{ UINT64_C(0xc21094364dfb5637), -821, -228 },
+	{ UINT64_C(0x9096ea6f3848984f), -794, -220 },
+	{ UINT64_C(0xd77485cb25823ac7), -768, -212 },
+	{ UINT64_C(0xa086cfcd97bf97f4), -741, -204 },
+	{ UINT64_C(0xef340a98172aace5), -715, -196 },
+	{ UINT64_C(0xb23867fb2a35b28e), -688, -188 },
+	{ UINT64_C(0x84c8d4dfd2c63f3b), -661, -180 },
+	{ UINT64_C(0xc5dd44271ad3cdba), -635, -172 },
+	{ UINT64_C(0x936b9fcebb25c996), -608, -164 },
+	{ UINT64_C(0xdbac6c247d62a584), -582, -156 },
+	{ UINT64_C(0xa3ab66580d5fdaf6), -555, -148 },
+	{ UINT64_C(0xf3e2f893dec3f126), -529, -140 },
+	{ UINT64_C(0xb5b5ada8aaff80b8), -502, -132 },
+	{ UINT64_C(0x87625f056c7c4a8b), -475, -124 },
+	{ UINT64_C(0xc9bcff6034c13053), -449, -116 },
+	{ UINT64_C(0x964e858c91ba2655), -422, -108 },
+	{ UINT64_C(0xdff9772470297ebd), -396, -100 },
+	{ UINT64_C(0xa6dfbd9fb8e5b88f), -369, -92 },
+	{ UINT64_C(0xf8a95fcf88747d94), -343, -84 },
+	{ UINT64_C(0xb94470938fa89bcf), -316, -76 },
+	{ UINT64_C(0x8a08f0f8bf0f156b), -289, -68 },
+	{ UINT64_C(0xcdb02555653131b6), -263, -60 },
+	{ UINT64_C(0x993fe2c6d07b7fac), -236, -52 },
+	{ UINT64_C(0xe45c10c42a2b3b06), -210, -44 },
+	{ UINT64_C(0xaa242499697392d3), -183, -36 },
+	{ UINT64_C(0xfd87b5f28300ca0e), -157, -28 },
+	{ UINT64_C(0xbce5086492111aeb), -130, -20 },
+	{ UINT64_C(0x8cbccc096f5088cc), -103, -12 },
+	{ UINT64_C(0xd1b71758e219652c), -77, -4 },
+	{ UINT64_C(0x9c40000000000000), -50, 4 },
+	{ UINT64_C(0xe8d4a51000000000), -24, 12 },
+	{ UINT64_C(0xad78ebc5ac620000), 3, 20 },
+	{ UINT64_C(0x813f3978f8940984), 30, 28 },
+	{ UINT64_C(0xc097ce7bc90715b3), 56, 36 },
+	{ UINT64_C(0x8f7e32ce7bea5c70), 83, 44 },
+	{ UINT64_C(0xd5d238a4abe98068), 109, 52 },
+	{ UINT64_C(0x9f4f2726179a2245), 136, 60 },
+	{ UINT64_C(0xed63a231d4c4fb27), 162, 68 },
+	{ UINT64_C(0xb0de65388cc8ada8), 189, 76 },
+	{ UINT64_C(0x83c7088e1aab65db), 216, 84 },
+	{ UINT64_C(0xc45d1df942711d9a), 242, 92 },
+	{ UINT64_C(0x924d692ca61be758), 269, 100 },
+	{ UINT64_C(0xda01ee641a708dea), 295, 108 },
+	{ UINT64_C(0xa26da3999aef774a), 322, 116 },
+	{ UINT64_C(0xf209787bb47d6b85), 348, 124 },
+	{ UINT64_C(0xb454e4a179dd1877), 375, 132 },
+	{ UINT64_C(0x865b86925b9bc5c2), 402, 140 },
+	{ UINT64_C(0xc83553c5c8965d3d), 428, 148 },
+	{ UINT64_C(0x952ab45cfa97a0b3), 455, 156 },
+	{ UINT64_C(0xde469fbd99a05fe3), 481, 164 },
+	{ UINT64_C(0xa59bc234db398c25), 508, 172 },
+	{ UINT64_C(0xf6c69a72a3989f5c), 534, 180 },
+	{ UINT64_C(0xb7dcbf5354e9bece), 561, 188 },
+	{ UINT64_C(0x88fcf317f22241e2), 588, 196 },
+	{ UINT64_C(0xcc20ce9bd35c78a5), 614, 204 },
+	{ UINT64_C(0x98165af37b2153df), 641, 212 },
+	{ UINT64_C(0xe2a0b5dc971f303a), 667, 220 },
+	{ UINT64_C(0xa8d9d1535ce3b396), 694, 228 },
+	{ UINT64_C(0xfb9b7cd9a4a7443c), 720, 236 },
+	{ UINT64_C(0xbb764c4ca7a44410), 747, 244 },
+	{ UINT64_C(0x8bab8eefb6409c1a), 774, 252 },
+	{ UINT64_C(0xd01fef10a657842c), 800, 260 },
+	{ UINT64_C(0x9b10a4e5e9913129), 827, 268 },
+	{ UINT64_C(0xe7109bfba19c0c9d), 853, 276 },
+	{ UINT64_C(0xac2820d9623bf429), 880, 284 },
+	{ UINT64_C(0x80444b5e7aa7cf85), 907, 292 },
+	{ UINT64_C(0xbf21e44003acdd2d), 933, 300 },
+	{ UINT64_C(0x8e679c2f5e44ff8f), 960, 308 },
+	{ UINT64_C(0xd433179d9c8cb841), 986, 316 },
+	{ UINT64_C(0x9e19db92b4e31ba9), 1013, 324 },
+	{ UINT64_C(0xeb96bf6ebadf77d9), 1039, 332 },
+	{ UINT64_C(0xaf87023b9bf0ee6b), 1066, 340 },
+};
+
+static inline
+struct Float multiplyFloat (struct Float x, struct Float y)
+{
+	const uint64_t m32 = 0xffffffff;
+	uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+	uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32) + (UINT64_C(1) << 31);
+	
+	return (struct Float){ ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+}
+
+static inline
+struct Float normalizeFloat (struct Float x)
+{
+	while (!(x.f & UINT64_C(0xffc0000000000000)))
+	{
+		x.f <<= 10;
+		x.e -= 10;
+	}
+	
+	while (!(x.f & UINT64_C(0x8000000000000000)))
+	{
+		x.f <<= 1;
+		--x.e;
+	}
+	
+	return x;
+}
+
+static
+int roundWeed (char *digits, int length, uint64_t distanceHighW, uint64_t unsafeInterval, uint64_t rest, uint64_t tenKappa, uint64_t unit)
+{
+	uint64_t smallDistance = distanceHighW - unit;
+	uint64_t bigDistance = distanceHighW + unit;
+	
+	// moves the last digit down while it stays inside the safe interval and gets closer to w
+	while (rest < smallDistance && unsafeInterval - rest >= tenKappa && (rest + tenKappa < smallDistance || smallDistance - rest >= rest + tenKappa - smallDistance))
+	{
+		--digits[length - 1];
+		rest += tenKappa;
+	}
+	
+	if (rest < bigDistance && unsafeInterval - rest >= tenKappa && (rest + tenKappa < bigDistance || bigDistance - rest > rest + tenKappa - bigDistance))
+		return 0;
+	
+	return 2 * unit <= rest && rest <= unsafeInterval - 4 * unit;
+}
+
+static
+int generateDigits (struct Float low, struct Float w, struct Float high, char *digits, int *length, int *kappa)
+{
+	uint64_t unit = 1;
+	struct Float tooLow = { low.f - unit, low.e };
+	struct Float tooHigh = { high.f + unit, high.e };
+	uint64_t unsafeInterval = tooHigh.f - tooLow.f;
+	struct Float one = { UINT64_C(1) << -w.e, w.e };
+	uint32_t integrals = (uint32_t)(tooHigh.f >> -one.e);
+	uint64_t fractionals = tooHigh.f & (one.f - 1);
+	uint32_t divisor = 1;
+	uint64_t rest;
+	
+	*kappa = 0;
+	*length = 0;
+	
+	if (integrals)
+		for (*kappa = 1; divisor <= integrals / 10; ++*kappa)
+			divisor *= 10;
+	
+	for (; *kappa > 0; divisor /= 10)
+	{
+		digits[(*length)++] = '0' + integrals / divisor;
+		integrals %= divisor;
+		--*kappa;
+		
+		rest = ((uint64_t)integrals << -one.e) + fractionals;
+		if (rest < unsafeInterval)
+			return roundWeed(digits, *length, tooHigh.f - w.f, unsafeInterval, rest, (uint64_t)divisor << -one.e, unit);
+	}
+	
+	for (;;)
+	{
+		fractionals *= 10;
+		unit *= 10;
+		unsafeInterval *= 10;
+		
+		digits[(*length)++] = '0' + (int)(fractionals >> -one.e);
+		fractionals &= one.f - 1;
+		--*kappa;
+		
+		if (fractionals < unsafeInterval)
+			return roundWeed(digits, *length, (tooHigh.f - w.f) * unit, unsafeInterval, fractionals, one.f, unit);
+	}
+}
+
+static
+int grisu3 (double binary, char *digits, int *length, int *exponent)
+{
+	union { double binary; uint64_t bits; } u = { binary };
+	uint64_t significand = u.bits & UINT64_C(0x000fffffffffffff);
+	int biased = (int)(u.bits >> 52) & 0x7ff;
+	struct Float v, w, plus, minus, power;
+	int k, index, kappa;
+	
+	if (biased)
+		v = (struct Float){ significand | UINT64_C(0x0010000000000000), biased - 1075 };
+	else
+		v = (struct Float){ significand, -1074 };
+	
+	w = normalizeFloat(v);
+	plus = normalizeFloat((struct Float){ (v.f << 1) + 1, v.e - 1 });
+	
+	// the gap below a power of two is half the gap above it
+	if (!significand && biased > 1)
+		minus = (struct Float){ (v.f << 2) - 1, v.e - 2 };
+	else
+		minus = (struct Float){ (v.f << 1) - 1, v.e - 1 };
+	
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+	
+	// a power of ten bringing the binary exponent of the product within [-60, -32]
+	k = (int)ceil((-60 - (w.e + 64) + 63) * 0.30102999566398114);
+	index = (348 + k - 1) / 8 + 1;
+	power = (struct Float){ cachedPowers[index].f, cachedPowers[index].e };
+	
+	if (!generateDigits(multiplyFloat(minus, power), multiplyFloat(w, power), multiplyFloat(plus, power), digits, length, &kappa))
+		return 0;
+	
+	*exponent = kappa - cachedPowers[index].k;
+	return 1;
+}
+
+static
+int shortestDigits (double binary, char digits[18], int *point)
+{
+	char buffer[32];
+	int length, exponent, precision, index;
+	
+	if (binary < 9007199254740992. && binary == (uint64_t)binary)
+	{
+		uint64_t integer = (uint64_t)binary;
+		
+		for (index = sizeof(buffer); integer; integer /= 10)
+			buffer[--index] = '0' + integer % 10;
+		
+		length = *point = (int)sizeof(buffer) - index;
+		memcpy(digits, buffer + index, length);
+		
+		while (digits[length - 1] == '0')
+			--length;
+		
+		return length;
+	}
+	
+	if (grisu3(binary, digits, &length, &exponent))
+	{
+		*point = exponent + length;
+		return length;
+	}
+	
+	for (precision = 1; precision <= 17; ++precision)
+	{
+		snprintf(buffer, sizeof(buffer), "%.*e", precision - 1, binary);
+		if (strtod(buffer, NULL) == binary)
+			break;
+	}
+	
+	for (index = 0, length = 0; buffer[index] != 'e'; ++index)
+		if (buffer[index] != '.')
+			digits[length++] = buffer[index];
+	
+	*point = atoi(buffer + index + 1) + 1;
+	return length;
+}
+
+static
+uint32_t formatBinary (char *bytes, double binary)
+{
+	char digits[18], *p = bytes;
+	int length, point, exponent;
+	
+	if (binary == 0)
+	{
+		*p++ = '0';
+		return 1;
+	}
+	
+	if (binary < 0)
+	{
+		*p++ = '-';
+		binary = -binary;
+	}
+	
+	length = shortestDigits(binary, digits, &point);
+	
+	// ES5 9.8.1
+	if (length <= point && point <= 21)
+	{
+		memcpy(p, digits, length);
+		memset(p + length, '0', point - length);
+		p += point;
+	}
+	else if (0 < point && point <= 21)
+	{
+		memcpy(p, digits, point);
+		p[point] = '.';
+		memcpy(p + point + 1, digits + point, length - point);
+		p += length + 1;
+	}
+	else if (-6 < point && point <= 0)
+	{
+		*p++ = '0';
+		*p++ = '.';
+		memset(p, '0', -point);
+		memcpy(p - point, digits, length);
+		p += length - point;
+	}
+	else
+	{
+		*p++ = digits[0];
+		if (length > 1)
+		{
+			*p++ = '.';
+			memcpy(p, digits + 1, length - 1);
+			p += length - 1;
+		}
+		
+		exponent = point - 1;
+		*p++ = 'e';
+		*p++ = exponent < 0? '-': '+';
+		p += sprintf(p, "%d", abs(exponent));
+	}
+	
+	return (uint32_t)(p - bytes);
+}
+
+static inline
+struct Chars(Rope) * ropeOf (struct Chars *self)
+{
+	return (struct Chars(Rope) *)(self + 1);
+}
+
+static inline
+struct Chars(View) * viewOf (struct Chars *self)
+{
+	return (struct Chars(View) *)(self + 1);
+}
+
+static inline
+struct Chars * leafOf (struct Chars *self, int last)
+{
+	while (self->flags & Chars(rope))
+		self = last && ropeOf(self)->right? ropeOf(self)->right: ropeOf(self)->left;
+	
+	return self;
+}
+
+static
+int splitsSurrogates (struct Chars *left, struct Chars *right)
+{
+	const uint8_t *tail, *head;
+	
+	left = leafOf(left, 1);
+	right = leafOf(right, 0);
+	
+	if (left->length < 3 || right->length < 3)
+		return 0;
+	
+	tail = (const uint8_t *)bytesOf(left) + left->length - 3;
+	head = (const uint8_t *)bytesOf(right);
+	
+	return tail[0] == 0xED && tail[1] >= 0xA0 && tail[1] <= 0xAF && head[0] == 0xED && head[1] >= 0xB0 && head[1] <= 0xBF;
+}
+
+static
+struct Chars * createJoined (struct Chars *left, struct Chars *right)
+{
+	struct Chars *self = createSized(left->length + right->length);
+	
+	memcpy(self->bytes, bytesOf(left), left->length);
+	memcpy(self->bytes + left->length, bytesOf(right), right->length);
+	return self;
+}
+
+static
+struct Chars * createNode (struct Chars *left, struct Chars *right)
+{
+	struct Chars *self = malloc(sizeof(*self) + sizeof(struct Chars(Rope)));
+	Pool.addChars(self);
+	*self = Chars.identity;
+	
+	self->length = left->length + right->length;
+	self->flags = Chars(rope);
+	ropeOf(self)->left = left;
+	ropeOf(self)->right = right;
+	++left->referenceCount;
+	++right->referenceCount;
+	
 	return self;
 }
 
@@ -130,19 +530,41 @@ struct Chars * createWithBytes (int32_t length, const char *bytes)
 void beginAppend (struct Chars(Append) *chars)
 {
 	chars->value = NULL;
+	chars->capacity = 0;
 	chars->units = 0;
 }
 
+void reserveAppend (struct Chars(Append) *chars, int32_t length)
+{
+	struct Chars *self = chars->value;
+	
+	reuseOrCreate(chars, (self? self->length: chars->units) + length);
+}
+
 void append (struct Chars(Append) *chars, const char *format, ...)
 {
+	char buffer[128];
 	uint32_t length;
 	va_list ap;
 	struct Chars *self = chars->value;
 	
+	if (!strchr(format, '%'))
+	{
+		appendBytes(chars, format, (int32_t)strlen(format));
+		return;
+	}
+	
+	// formats once when the result fits on the stack, which is the common case
 	va_start(ap, format);
-	length = vsnprintf(NULL, 0, format, ap);
+	length = vsnprintf(buffer, sizeof(buffer), format, ap);
 	va_end(ap);
 	
+	if (length < sizeof(buffer))
+	{
+		appendBytes(chars, buffer, length);
+		return;
+	}
+	
 	self = reuseOrCreate(chars, (self? self->length: chars->units) + length);
 	
 	va_start(ap, format);
@@ -155,6 +577,34 @@ void append (struct Chars(Append) *chars, const char *format, ...)
 		chars->units += length;
 }
 
+void appendBytes (struct Chars(Append) *chars, const char *bytes, int32_t length)
+{
+	struct Chars *self = chars->value;
+	
+	self = reuseOrCreate(chars, (self? self->length: chars->units) + length);
+	memcpy(self? (self->bytes + self->length): (chars->buffer + chars->units), bytes, length);
+	
+	if (self)
+		self->length += length;
+	else
+		chars->units += length;
+}
+
+void appendInt32 (struct Chars(Append) *chars, int32_t integer)
+{
+	char buffer[11], *digits = buffer + sizeof(buffer);
+	uint32_t magnitude = integer < 0? -(uint32_t)integer: (uint32_t)integer;
+	
+	do
+		*(--digits) = '0' + magnitude % 10;
+	while (magnitude /= 10);
+	
+	if (integer < 0)
+		*(--digits) = '-';
+	
+	appendBytes(chars, digits, (int32_t)(buffer + sizeof(buffer) - digits));
+}
+
 static
 void appendText (struct Chars(Append) * chars, struct Text text)
 {
@@ -244,7 +694,7 @@ void appendValue (struct Chars(Append) *chars, struct Context * const context, s
 			return;
 			
 		case Value(integerType):
-			appendBinary(chars, value.data.integer, 10);
+			appendInt32(chars, value.data.integer);
 			return;
 			
 		case Value(numberType):
@@ -270,18 +720,6 @@ void appendValue (struct Chars(Append) *chars, struct Context * const context, s
 	Ecc.fatal("Invalid Value(Type) : %u", value.type);
 }
 
-static
-uint32_t stripBinaryOfBytes (char *bytes, uint32_t length)
-{
-	while (bytes[length - 1] == '0')
-		bytes[--length] = '\0';
-	
-	if (bytes[length - 1] == '.')
-		bytes[--length] = '\0';
-	
-	return length;
-}
-
 static
 uint32_t normalizeBinaryOfBytes (char *bytes, uint32_t length)
 {
@@ -320,27 +758,9 @@ void appendBinary (struct Chars(Append) *chars, double binary, int base)
 	
 	if (!base || base == 10)
 	{
-		if (binary <= -1e+21 || binary >= 1e+21)
-			append(chars, "%g", binary);
-		else if ((binary < 1 && binary >= 0.000001) || (binary > -1 && binary <= -0.000001))
-		{
-			append(chars, "%.10f", binary);
-			if (chars->value)
-				chars->value->length = stripBinaryOfBytes(chars->value->bytes, chars->value->length);
-			else
-				chars->units = stripBinaryOfBytes(chars->buffer, chars->units);
-			
-			return;
-		}
-		else
-		{
-			double dblDig10 = pow(10, DBL_DIG);
-			int precision = binary >= -dblDig10 && binary <= dblDig10? DBL_DIG: 21;
-			
-			append(chars, "%.*g", precision, binary);
-		}
+		char buffer[32];
 		
-		normalizeBinary(chars);
+		appendBytes(chars, buffer, formatBinary(buffer, binary));
 		return;
 	}
 	else
@@ -369,7 +789,7 @@ void appendBinary (struct Chars(Append) *chars, double binary, int base)
 				*(--p) = '-';
 			
 			count = buffer + sizeof(buffer) - 1 - p;
-			append(chars, "%.*s", count, p);
+			appendBytes(chars, p, count);
 		}
 	}
 }
@@ -395,10 +815,230 @@ struct Value endAppend (struct Chars(Append) *chars)
 		return Value.buffer(chars->buffer, chars->units);
 }
 
+struct Chars * createRope (struct Chars *left, struct Chars *right)
+{
+	struct Chars(Rope) *rope;
+	
+	assert(left);
+	assert(right);
+	
+	if ((left->flags & Chars(rope)) && !ropeOf(left)->right)
+		left = ropeOf(left)->left;
+	
+	if ((right->flags & Chars(rope)) && !ropeOf(right)->right)
+		right = ropeOf(right)->left;
+	
+	if (splitsSurrogates(left, right) || left->referenceCount >= INT16_MAX - 1 || right->referenceCount >= INT16_MAX - 1)
+	{
+		struct Chars(Append) chars;
+		struct Value value;
+		
+		beginAppend(&chars);
+		appendText(&chars, Text.make(bytesOf(left), left->length));
+		appendText(&chars, Text.make(bytesOf(right), right->length));
+		value = endAppend(&chars);
+		
+		return value.type == Value(charsType)? value.data.chars: createWithBytes(value.data.buffer[7], value.data.buffer);
+	}
+	
+	// short pieces on the growing side are copied together rather than adding a level per append
+	if (!(right->flags & Chars(rope)) && (left->flags & Chars(rope)))
+	{
+		rope = ropeOf(left);
+		if (!(rope->right->flags & Chars(rope)) && rope->right->length + right->length <= Chars(ropeLength))
+			return createNode(rope->left, createJoined(rope->right, right));
+	}
+	else if (!(left->flags & Chars(rope)) && (right->flags & Chars(rope)))
+	{
+		rope = ropeOf(right);
+		if (!(rope->left->flags & Chars(rope)) && left->length + rope->left->length <= Chars(ropeLength))
+			return createNode(createJoined(left, rope->left), rope->right);
+	}
+	
+	return createNode(left, right);
+}
+
+struct Chars * flatten (struct Chars *self)
+{
+	struct Chars(Rope) *rope;
+	struct Chars *flat, *node, *leaf, **stack = NULL;
+	uint32_t count = 0, capacity = 0;
+	int32_t offset;
+	
+	assert(self);
+	
+	if (!(self->flags & Chars(rope)))
+		return self;
+	
+	rope = ropeOf(self);
+	if (!rope->right)
+		return rope->left;
+	
+	flat = createSized(self->length);
+	offset = self->length;
+	node = self;
+	
+	// filled from the end; pending left sides are kept on a heap stack so that long chains do not recurse
+	for (;;)
+	{
+		if ((node->flags & Chars(rope)) && ropeOf(node)->right)
+		{
+			if (count >= capacity)
+			{
+				capacity = capacity? capacity * 2: 16;
+				stack = realloc(stack, sizeof(*stack) * capacity);
+			}
+			stack[count++] = ropeOf(node)->left;
+			node = ropeOf(node)->right;
+			continue;
+		}
+		
+		leaf = node->flags & Chars(rope)? ropeOf(node)->left: node;
+		offset -= leaf->length;
+		memcpy(flat->bytes + offset, bytesOf(leaf), leaf->length);
+		
+		if (!count)
+			break;
+		
+		node = stack[--count];
+	}
+	
+	free(stack), stack = NULL;
+	
+	--rope->left->referenceCount;
+	--rope->right->referenceCount;
+	++flat->referenceCount;
+	rope->left = flat;
+	rope->right = NULL;
+	
+	return flat;
+}
+
+struct Chars * createView (struct Chars *parent, int32_t offset, int32_t length)
+{
+	struct Chars *self;
+	
+	assert(parent);
+	assert(offset >= 0 && offset + length <= parent->length);
+	
+	parent = flatten(parent);
+	if (parent->flags & Chars(view))
+	{
+		offset += viewOf(parent)->offset;
+		parent = viewOf(parent)->parent;
+	}
+	
+	if (!offset && length == parent->length)
+		return parent;
+	
+	// short slices are cheaper to copy, and small ones would keep a much larger parent alive
+	if (length < Chars(viewLength) || length < parent->length / 16 || parent->referenceCount >= INT16_MAX - 1)
+	{
+		self = createWithBytes(length, parent->bytes + offset);
+		self->flags |= parent->flags & Chars(asciiOnly);
+		return self;
+	}
+	
+	self = malloc(sizeof(*self) + sizeof(struct Chars(View)));
+	Pool.addChars(self);
+	*self = Chars.identity;
+	
+	self->length = length;
+	self->flags = Chars(view) | (parent->flags & Chars(asciiOnly));
+	viewOf(self)->parent = parent;
+	viewOf(self)->offset = offset;
+	++parent->referenceCount;
+	
+	return self;
+}
+
+const char * bytesOf (struct Chars *self)
+{
+	assert(self);
+	
+	if (self->flags & Chars(view))
+		return viewOf(self)->parent->bytes + viewOf(self)->offset;
+	else if (self->flags & Chars(rope))
+		return flatten(self)->bytes;
+	else
+		return self->bytes;
+}
+
+int32_t unitLength (struct Chars *self)
+{
+	struct Chars(Index) *index;
+	struct Text text;
+	struct Text(Char) c;
+	const char *bytes;
+	int32_t offset, units, capacity;
+	
+	assert(self);
+	assert(!(self->flags & Chars(rope)));
+	
+	if (self->flags & Chars(asciiOnly))
+		return self->length;
+	else if (self->index)
+		return self->index->units;
+	
+	bytes = bytesOf(self);
+	
+	if (Text.asciiLength(Text.make(bytes, self->length)) == self->length)
+	{
+		self->flags |= Chars(asciiOnly);
+		return self->length;
+	}
+	
+	capacity = self->length / Chars(indexStride) + 1;
+	index = malloc(sizeof(*index) + sizeof(*index->marks) * (capacity - 1));
+	index->count = 0;
+	
+	text = Text.make(bytes, self->length);
+	units = 0;
+	
+	while (text.length)
+	{
+		offset = (int32_t)(text.bytes - bytes);
+		c = Text.nextCharacter(&text);
+		
+		if (!(units % Chars(indexStride)) || (c.codepoint > 0xffff && !((units + 1) % Chars(indexStride))))
+		{
+			index->marks[index->count].offset = offset;
+			index->marks[index->count].unit = units;
+			++index->count;
+		}
+		
+		units += c.codepoint > 0xffff? 2: 1;
+	}
+	
+	index->units = units;
+	self->index = index;
+	
+	return units;
+}
+
+void release (struct Chars *self)
+{
+	struct Chars(Rope) *rope;
+	
+	assert(self);
+	
+	if (self->flags & Chars(rope))
+	{
+		rope = ropeOf(self);
+		--rope->left->referenceCount;
+		
+		if (rope->right)
+			--rope->right->referenceCount;
+	}
+	else if (self->flags & Chars(view))
+		--viewOf(self)->parent->referenceCount;
+}
+
 void destroy (struct Chars *self)
 {
 	assert(self);
 	
+	free(self->index), self->index = NULL;
 	free(self), self = NULL;
 }
 
@@ -25,14 +25,45 @@
 	{
 		Chars(mark) = 1 << 0,
 		Chars(asciiOnly) = 1 << 1,
+		Chars(rope) = 1 << 2,
+		Chars(view) = 1 << 3,
+	};
+
+	enum {
+		Chars(ropeLength) = 256,
+		Chars(indexStride) = 64,
+		Chars(viewLength) = 64,
 	};
 
 	struct Chars(Append) {
 		struct Chars *value;
+		int32_t capacity;
 		char buffer[9];
 		uint8_t units;
 	};
 	
+	/* stored after the header of rope chars; right is NULL once flattened into left */
+	struct Chars(Rope) {
+		struct Chars *left;
+		struct Chars *right;
+	};
+	
+	/* stored after the header of view chars, whose bytes are those of a flat parent */
+	struct Chars(View) {
+		struct Chars *parent;
+		int32_t offset;
+	};
+	
+	/* byte offset of the character holding each Chars(indexStride)th UTF-16 unit, and its unit position */
+	struct Chars(Index) {
+		int32_t units;
+		int32_t count;
+		struct {
+			int32_t offset;
+			int32_t unit;
+		} marks[1];
+	};
+	
 #endif
 
 
@@ -44,13 +75,24 @@ Interface(Chars,
 	(struct Chars *, createWithBytes ,(int32_t length, const char *bytes))
 	
 	(void, beginAppend ,(struct Chars(Append) *))
+	(void, reserveAppend ,(struct Chars(Append) *, int32_t length))
 	(void, append ,(struct Chars(Append) *, const char *format, ...))
+	(void, appendBytes ,(struct Chars(Append) *, const char *bytes, int32_t length))
+	(void, appendInt32 ,(struct Chars(Append) *, int32_t integer))
 	(void, appendCodepoint ,(struct Chars(Append) *, uint32_t cp))
 	(void, appendValue ,(struct Chars(Append) *, struct Context * const context, struct Value value))
 	(void, appendBinary ,(struct Chars(Append) *, double binary, int base))
 	(void, normalizeBinary ,(struct Chars(Append) *))
 	(struct Value, endAppend ,(struct Chars(Append) *))
 	
+	(struct Chars *, createRope ,(struct Chars *left, struct Chars *right))
+	(struct Chars *, flatten ,(struct Chars *))
+	(struct Chars *, createView ,(struct Chars *parent, int32_t offset, int32_t length))
+	(const char *, bytesOf ,(struct Chars *))
+	
+	(int32_t, unitLength ,(struct Chars *))
+	
+	(void, release ,(struct Chars *))
 	(void, destroy ,(struct Chars *))
 	
 	(uint8_t, codepointLength ,(uint32_t cp))
@@ -60,6 +102,7 @@ Interface(Chars,
 		int32_t length;
 		int16_t referenceCount;
 		uint8_t flags;
+		struct Chars(Index) *index;
 		char bytes[1];
 	}
 )
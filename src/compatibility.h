@@ -33,6 +33,35 @@
 		#define io_libecc_ecc_noreturn
 	#endif
 
+	#if __STDC_VERSION__ >= 201112L && !__STDC_NO_THREADS__
+		#define io_libecc_ecc_threadLocal _Thread_local
+	#elif __GNUC__
+		#define io_libecc_ecc_threadLocal __thread
+	#elif _MSC_VER
+		#define io_libecc_ecc_threadLocal __declspec(thread)
+	#else
+		/* no thread-local storage: pool, keys & builtins are process-wide */
+		#define io_libecc_ecc_threadLocal
+		#define io_libecc_ecc_threadSafe 0
+	#endif
+
+	#ifndef io_libecc_ecc_threadSafe
+		#if (__unix__ && !__MSDOS__) || (defined(__APPLE__) && defined(__MACH__)) || _WIN32
+			/* instances may run concurrently, one thread each */
+			#define io_libecc_ecc_threadSafe 1
+		#else
+			/* no lock to serialize env setup: use instances from a single thread */
+			#define io_libecc_ecc_threadSafe 0
+		#endif
+	#endif
+
+	#if __GNUC__
+		/* conservative scans read whole stacks, redzones included */
+		#define io_libecc_ecc_noSanitize __attribute__((no_sanitize_address))
+	#else
+		#define io_libecc_ecc_noSanitize
+	#endif
+
 	#if __GNUC__ && _WIN32 && !_MSC_VER
 		/* use ebp frame */
 		#define io_libecc_ecc_useframe __attribute__((optimize("no-omit-frame-pointer")))
@@ -40,6 +69,13 @@
 		#define io_libecc_ecc_useframe
 	#endif
 
+	#if __GNUC__ && (__i386__ || __x86_64__)
+		/* builtin jump, saves frame & stack pointers only */
+		#define io_libecc_ecc_lightjmp 1
+	#else
+		#define io_libecc_ecc_lightjmp 0
+	#endif
+
 	#if (__STDC_VERSION__ < 199901L)
 		#ifdef __GNUC__
 			#define inline __inline__
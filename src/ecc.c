@@ -10,13 +10,41 @@
 #include "ecc.h"
 
 #include "parser.h"
+#include "bytecode.h"
+#include "snapshot.h"
 #include "oplist.h"
 #include "pool.h"
+#include "profile.h"
 
 // MARK: - Private
 
+#if (__unix__ && !__MSDOS__) || (defined(__APPLE__) && defined(__MACH__))
+	#include <pthread.h>
+	static pthread_mutex_t instanceMutex = PTHREAD_MUTEX_INITIALIZER;
+	#define lockInstances() pthread_mutex_lock(&instanceMutex)
+	#define unlockInstances() pthread_mutex_unlock(&instanceMutex)
+#elif _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	static SRWLOCK instanceLock = SRWLOCK_INIT;
+	#define lockInstances() AcquireSRWLockExclusive(&instanceLock)
+	#define unlockInstances() ReleaseSRWLockExclusive(&instanceLock)
+#else
+	/* single-threaded platforms, see Ecc(threadSafe) */
+	#define lockInstances()
+	#define unlockInstances()
+#endif
+
+/* env is process-wide, set up by the first instance and torn down by the last */
 static int instanceCount = 0;
 
+/* pool, keys & builtin objects are per thread */
+static Ecc(threadLocal) int threadInstanceCount = 0;
+static Ecc(threadLocal) struct Ecc *threadInstances = NULL;
+
+/* instance whose patches are currently swapped into the shared builtins */
+static Ecc(threadLocal) struct Ecc *activeInstance = NULL;
+
 // MARK: - Static Members
 
 static
@@ -26,6 +54,141 @@ void addInput(struct Ecc *self, struct Input *input)
 	self->inputs[self->inputCount++] = input;
 }
 
+static
+void releaseInputs (struct Ecc *self)
+{
+	struct Input *input;
+	
+	while (self->inputCount)
+	{
+		input = self->inputs[--self->inputCount];
+		Key.copyTextsOf(input->bytes, input->length);
+		Input.destroy(input), self->inputs[self->inputCount] = NULL;
+	}
+}
+
+static
+void shareObject (struct Object *object)
+{
+	uint32_t index, count;
+	
+	if (object->flags & Object(shared))
+		return;
+	
+	object->flags |= Object(shared);
+	
+	if (object->prototype)
+		shareObject(object->prototype);
+	
+	for (index = 0, count = object->elementCount; index < count; ++index)
+		if (object->element[index].value.check == 1 && object->element[index].value.type >= Value(objectType))
+			shareObject(object->element[index].value.data.object);
+	
+	for (index = 2, count = object->hashmapCount; index < count; ++index)
+		if (object->hashmap[index].value.check == 1 && object->hashmap[index].value.type >= Value(objectType))
+			shareObject(object->hashmap[index].value.data.object);
+}
+
+static
+void shareBuiltins (void)
+{
+	struct Function * const roots[] = {
+		Object(constructor), Function(constructor), Array(constructor), String(constructor),
+		Boolean(constructor), Number(constructor), Date(constructor), RegExp(constructor),
+		Error(constructor), Error(rangeConstructor), Error(referenceConstructor), Error(syntaxConstructor),
+		Error(typeConstructor), Error(uriConstructor), Error(evalConstructor),
+	};
+	uint32_t index, count;
+	
+	shareObject(Object(prototype));
+	shareObject(Function(prototype));
+	shareObject(Arguments(prototype));
+	shareObject(Math(object));
+	shareObject(JSON(object));
+	for (index = 0, count = sizeof(roots) / sizeof(*roots); index < count; ++index)
+		shareObject(&roots[index]->object);
+}
+
+static
+void swapPatches (struct Ecc *self)
+{
+	struct Object content;
+	uint16_t index;
+	
+	for (index = 0; index < self->patchCount; ++index)
+	{
+		struct Ecc(Patch) *patch = &self->patches[index];
+		
+		content = *patch->object;
+		*patch->object = patch->content;
+		patch->object->flags = (patch->content.flags & ~Object(mark)) | (content.flags & Object(mark));
+		patch->object->referenceCount = content.referenceCount;
+		patch->content = content;
+	}
+}
+
+static
+void releasePatches (struct Ecc *self)
+{
+	while (self->patchCount--)
+	{
+		free(self->patches[self->patchCount].content.hashmap);
+		free(self->patches[self->patchCount].content.element);
+	}
+	self->patchCount = 0;
+}
+
+static
+void markContent (struct Object *content)
+{
+	uint32_t index, count;
+	
+	if (content->prototype)
+		Pool.markObject(content->prototype);
+	
+	for (index = 0, count = content->elementCount; index < count; ++index)
+		if (content->element[index].value.check == 1)
+			Pool.markValue(content->element[index].value);
+	
+	for (index = 2, count = content->hashmapCount; index < count; ++index)
+		if (content->hashmap[index].value.check == 1)
+			Pool.markValue(content->hashmap[index].value);
+}
+
+static
+void markRoots(struct Ecc *self)
+{
+	uint16_t index, count;
+	
+	Pool.markValue(Value.function(self->global));
+	
+	for (index = 0, count = self->patchCount; index < count; ++index)
+		markContent(&self->patches[index].content);
+	
+	for (index = 0, count = self->rootCount; index < count; ++index)
+		Pool.markObject(self->roots[index]);
+	
+	for (index = 0, count = self->inputCount; index < count; ++index)
+	{
+		struct Input *input = self->inputs[index];
+		uint16_t a = input->attachedCount;
+		
+		while (a--)
+			Pool.markValue(input->attached[a]);
+	}
+	
+	if (self->snapshot)
+		markRoots(self->snapshot->ecc);
+}
+
+static
+void resetBudget(struct Ecc *self)
+{
+	self->stepCountdown = 0;
+	self->stepCount = 0;
+	self->timeLimit = self->maximumTime > 0? Env.currentTime() + self->maximumTime: 0;
+}
+
 // MARK: - Methods
 
 uint32_t Ecc(version) = (0 << 24) | (1 << 16) | (0 << 0);
@@ -34,41 +197,121 @@ struct Ecc *create (void)
 {
 	struct Ecc *self;
 	
+	lockInstances();
 	if (!instanceCount++)
-	{
 		Env.setup();
+	unlockInstances();
+	
+	if (!threadInstanceCount++)
+	{
 		Pool.setup();
 		Key.setup();
 		Global.setup();
+		shareBuiltins();
 	}
 	
 	self = malloc(sizeof(*self));
 	*self = Ecc.identity;
 	
+	self->nextInstance = threadInstances;
+	threadInstances = self;
+	
 	self->global = Global.create();
 	self->maximumCallDepth = 512;
 	
 	return self;
 }
 
+struct Ecc *createWithSnapshot (struct Snapshot *snapshot)
+{
+	struct Ecc *self;
+	
+	assert(snapshot);
+	assert(threadInstanceCount);
+	
+	lockInstances();
+	++instanceCount;
+	unlockInstances();
+	++threadInstanceCount;
+	
+	self = malloc(sizeof(*self));
+	*self = Ecc.identity;
+	
+	self->nextInstance = threadInstances;
+	threadInstances = self;
+	
+	self->global = Snapshot.restoreGlobal(snapshot);
+	self->snapshot = snapshot;
+	self->maximumCallDepth = snapshot->ecc->maximumCallDepth;
+	self->maximumSteps = snapshot->ecc->maximumSteps;
+	self->maximumTime = snapshot->ecc->maximumTime;
+	
+	return self;
+}
+
 void destroy (struct Ecc *self)
 {
+	struct Ecc **instance;
+	
 	assert(self);
 	
+	Profile.stop(self);
+	
+	if (activeInstance == self)
+		activate(NULL);
+	
+	releasePatches(self);
+	free(self->patches), self->patches = NULL;
+	
+	for (instance = &threadInstances; *instance; instance = &(*instance)->nextInstance)
+		if (*instance == self)
+		{
+			*instance = self->nextInstance;
+			break;
+		}
+	
+	// keys of the thread outlive the instance when others remain
+	if (threadInstances)
+		releaseInputs(self);
+	
 	while (self->inputCount--)
 		Input.destroy(self->inputs[self->inputCount]), self->inputs[self->inputCount] = NULL;
 	
 	free(self->inputs), self->inputs = NULL;
+	free(self->roots), self->roots = NULL;
 	free(self->envList), self->envList = NULL;
 	free(self), self = NULL;
 	
-	if (!--instanceCount)
+	if (!--threadInstanceCount)
 	{
 		Global.teardown();
 		Key.teardown();
 		Pool.teardown();
-		Env.teardown();
 	}
+	
+	lockInstances();
+	if (!--instanceCount)
+		Env.teardown();
+	unlockInstances();
+}
+
+void reset (struct Ecc *self)
+{
+	assert(self);
+	
+	if (activeInstance == self)
+		activate(NULL);
+	
+	releasePatches(self);
+	self->rootCount = 0;
+	self->global = self->snapshot? Snapshot.restoreGlobal(self->snapshot): Global.create();
+	self->result = Value(undefined);
+	self->text = self->ofText = Text(empty);
+	self->ofInput = NULL;
+	
+	// once the previous global is collected, only keys still point into the inputs
+	garbageCollect(self);
+	releaseInputs(self);
 }
 
 void addFunction (struct Ecc *self, const char *name, const Native(Function) native, int argumentCount, enum Value(Flags) flags)
@@ -100,10 +343,12 @@ int evalInput (struct Ecc *self, struct Input *input, enum Ecc(EvalFlags) flags)
 		return EXIT_FAILURE;
 	
 	self->sloppyMode = flags & Ecc(sloppyMode);
+	self->lazyFunctions = (flags & Ecc(lazyFunctions)) != 0;
 	
 	if (trap)
 	{
 		self->printLastThrow = 1;
+		resetBudget(self);
 		catch = setjmp(*pushEnv(self));
 	}
 	
@@ -112,6 +357,12 @@ int evalInput (struct Ecc *self, struct Input *input, enum Ecc(EvalFlags) flags)
 	else
 		evalInputWithContext(self, input, &context);
 	
+	if (trap)
+	{
+		self->interruptRequest = 0;
+		resetBudget(self);
+	}
+	
 	if (flags & Ecc(primitiveResult))
 	{
 		Context.rewindStatement(&context);
@@ -127,6 +378,7 @@ int evalInput (struct Ecc *self, struct Input *input, enum Ecc(EvalFlags) flags)
 	{
 		popEnv(self);
 		self->printLastThrow = 0;
+		self->interruptRequest = 0;
 	}
 	
 	return result;
@@ -137,10 +389,12 @@ void evalInputWithContext (struct Ecc *self, struct Input *input, struct Context
 	struct Lexer *lexer;
 	struct Parser *parser;
 	struct Function *function;
+	struct Context *current;
 	
 	assert(self);
 	assert(self->envCount);
 	
+	activate(self);
 	addInput(self, input);
 	
 	lexer = Lexer.createWithInput(input);
@@ -152,9 +406,16 @@ void evalInputWithContext (struct Ecc *self, struct Input *input, struct Context
 	if (self->sloppyMode)
 		lexer->allowUnicodeOutsideLiteral = 1;
 	
-	function = Parser.parseWithEnvironment(parser, context->environment, &self->global->environment);
+	if (self->lazyFunctions)
+		parser->lazyFunctions = 1;
+	
+	function = Bytecode.readWithEnvironment(parser, context->environment, &self->global->environment);
+	if (!function)
+		function = Parser.parseWithEnvironment(parser, context->environment, &self->global->environment);
+	
 	context->ops = function->oplist->ops;
 	context->environment = &function->environment;
+	self->lazyFunctionCount += parser->lazyFunctionCount;
 	
 	Parser.destroy(parser), parser = NULL;
 	
@@ -163,7 +424,105 @@ void evalInputWithContext (struct Ecc *self, struct Input *input, struct Context
 	
 	self->result = Value(undefined);
 	
+	current = self->current;
+	self->current = context;
 	context->ops->native(context);
+	self->current = current;
+}
+
+Ecc(useframe)
+int callFunction (struct Ecc *self, struct Function *function, struct Value this, struct Object *arguments)
+{
+	volatile int result = EXIT_SUCCESS, trap = !self->envCount, catch = 0;
+	struct Object empty = Object.identity;
+	struct Context *current;
+	struct Context context = {
+		.environment = &self->global->environment,
+		.this = Value.object(&self->global->environment),
+		.ecc = self,
+	};
+	
+	assert(self);
+	assert(function);
+	
+	activate(self);
+	
+	if (trap)
+	{
+		self->printLastThrow = 1;
+		resetBudget(self);
+		catch = setjmp(*pushEnv(self));
+	}
+	
+	current = self->current;
+	
+	if (catch)
+		result = EXIT_FAILURE;
+	else
+	{
+		self->current = &context;
+		self->result = Op.callFunctionArguments(&context, 0, function, this, arguments? arguments: &empty);
+	}
+	
+	self->current = current;
+	
+	if (trap)
+	{
+		popEnv(self);
+		self->printLastThrow = 0;
+		self->interruptRequest = 0;
+		resetBudget(self);
+	}
+	
+	return result;
+}
+
+Ecc(useframe)
+int compileInput (struct Ecc *self, struct Input *input, const char *filename, enum Ecc(EvalFlags) flags)
+{
+	volatile int result = EXIT_FAILURE;
+	struct Lexer *lexer;
+	struct Parser *parser;
+	struct Function *function;
+	struct Context context = {
+		.environment = &self->global->environment,
+		.this = Value.object(&self->global->environment),
+		.ecc = self,
+		.strictMode = !(flags & Ecc(sloppyMode)),
+	};
+	
+	assert(self);
+	assert(filename);
+	
+	if (!input)
+		return EXIT_FAILURE;
+	
+	addInput(self, input);
+	
+	lexer = Lexer.createWithInput(input);
+	parser = Parser.createWithLexer(lexer);
+	parser->strictMode = context.strictMode;
+	lexer->allowUnicodeOutsideLiteral = !context.strictMode;
+	
+	function = Parser.parseWithEnvironment(parser, context.environment, &self->global->environment);
+	
+	if (parser->error)
+	{
+		int printLastThrow = self->printLastThrow;
+		
+		self->printLastThrow = !self->envCount;
+		if (!setjmp(*pushEnv(self)))
+			Context.throw(&context, Value.error(parser->error));
+		
+		popEnv(self);
+		self->printLastThrow = printLastThrow;
+	}
+	else if (Bytecode.writeFile(parser, function, filename))
+		result = EXIT_SUCCESS;
+	
+	Parser.destroy(parser), parser = NULL;
+	
+	return result;
 }
 
 jmp_buf * pushEnv(struct Ecc *self)
@@ -175,7 +534,19 @@ jmp_buf * pushEnv(struct Ecc *self)
 		memset(self->envList + self->envCapacity, 0, sizeof(*self->envList) * (capacity - self->envCapacity));
 		self->envCapacity = capacity;
 	}
-	return &self->envList[self->envCount++];
+	self->envList[self->envCount].context = self->current;
+	self->envList[self->envCount].light = 0;
+	#if PROFILE
+	self->envList[self->envCount].profileDepth = Profile.depth();
+	#endif
+	return &self->envList[self->envCount++].buf;
+}
+
+jmp_buf * pushLightEnv(struct Ecc *self)
+{
+	jmp_buf *env = pushEnv(self);
+	self->envList[self->envCount - 1].light = Ecc(lightjmp);
+	return env;
 }
 
 void popEnv(struct Ecc *self)
@@ -195,7 +566,23 @@ void jmpEnv (struct Ecc *self, struct Value value)
 	if (value.type == Value(errorType))
 		self->text = value.data.error->text;
 	
-	longjmp(self->envList[self->envCount - 1], 1);
+	self->current = self->envList[self->envCount - 1].context;
+	
+	#if PROFILE
+	Profile.unwind(self->envList[self->envCount - 1].profileDepth);
+	#endif
+	
+	#if Ecc(lightjmp)
+	if (self->envList[self->envCount - 1].light)
+		__builtin_longjmp((void **)self->envList[self->envCount - 1].buf, 1);
+	#endif
+	
+	longjmp(self->envList[self->envCount - 1].buf, 1);
+}
+
+void interrupt (struct Ecc *self, enum Ecc(Interrupt) interrupt)
+{
+	self->interruptRequest = interrupt;
 }
 
 void fatal (const char *format, ...)
@@ -228,6 +615,9 @@ struct Input * findInput (struct Ecc *self, struct Text text)
 		if (text.bytes >= self->inputs[i]->bytes && text.bytes <= self->inputs[i]->bytes + self->inputs[i]->length)
 			return self->inputs[i];
 	
+	if (self->snapshot)
+		return findInput(self->snapshot->ecc, text);
+	
 	return NULL;
 }
 
@@ -257,20 +647,95 @@ void printTextInput (struct Ecc *self, struct Text text, int fullLine)
 
 void garbageCollect(struct Ecc *self)
 {
-	uint16_t index, count;
+	struct Ecc *instance;
 	
+	assert(self);
+	
+	// the pool is shared by every instance of the thread
 	Pool.unmarkAll();
 	Pool.markValue(Value.object(Arguments(prototype)));
-	Pool.markValue(Value.function(self->global));
+	for (instance = threadInstances; instance; instance = instance->nextInstance)
+		markRoots(instance);
 	
-	for (index = 0, count = self->inputCount; index < count; ++index)
+	Pool.collectUnmarked();
+}
+
+void addRoot (struct Ecc *self, struct Object *object)
+{
+	assert(self);
+	assert(object);
+	
+	self->roots = realloc(self->roots, sizeof(*self->roots) * (self->rootCount + 1));
+	self->roots[self->rootCount++] = object;
+}
+
+void removeRoot (struct Ecc *self, struct Object *object)
+{
+	uint16_t index;
+	
+	assert(self);
+	
+	for (index = 0; index < self->rootCount; ++index)
+		if (self->roots[index] == object)
+		{
+			self->roots[index] = self->roots[--self->rootCount];
+			break;
+		}
+}
+
+void activate (struct Ecc *self)
+{
+	if (activeInstance == self)
+		return;
+	
+	if (activeInstance)
+		swapPatches(activeInstance);
+	
+	if (( activeInstance = self ))
+		swapPatches(self);
+}
+
+void unshareObject (struct Object *object)
+{
+	struct Ecc *self = activeInstance;
+	struct Ecc(Patch) *patch;
+	size_t size;
+	
+	assert(object);
+	
+	// writes made outside of any instance change what all instances see
+	if (!self)
+		return;
+	
+	if (self->patchCount >= self->patchCapacity)
 	{
-		struct Input *input = self->inputs[index];
-		uint16_t a = input->attachedCount;
-		
-		while (a--)
-			Pool.markValue(input->attached[a]);
+		self->patchCapacity = self->patchCapacity? self->patchCapacity * 2: 8;
+		self->patches = realloc(self->patches, sizeof(*self->patches) * self->patchCapacity);
 	}
 	
-	Pool.collectUnmarked();
+	patch = &self->patches[self->patchCount++];
+	patch->object = object;
+	patch->content = *object;
+	
+	size = sizeof(*object->hashmap) * object->hashmapCapacity;
+	patch->content.hashmap = size? memcpy(malloc(size), object->hashmap, size): NULL;
+	
+	size = sizeof(*object->element) * object->elementCapacity;
+	patch->content.element = size? memcpy(malloc(size), object->element, size): NULL;
+	
+	object->flags &= ~Object(shared);
+}
+
+void publishBuiltins (struct Ecc *self)
+{
+	uint16_t index;
+	
+	assert(self);
+	
+	activate(self);
+	
+	for (index = 0; index < self->patchCount; ++index)
+		self->patches[index].object->flags |= Object(shared);
+	
+	releasePatches(self);
 }
@@ -17,13 +17,39 @@
 
 	#include "builtin/global.h"
 	#include "input.h"
+	
+	struct Snapshot;
 
 	enum Ecc(EvalFlags) {
 		Ecc(sloppyMode)         = 0x1 /* 0000 0001 */,
 		Ecc(primitiveResult)    = 0x2 /* 0000 0010 */,
 		Ecc(stringResult)       = 0x6 /* 0000 0110 */,
+		Ecc(lazyFunctions)      = 0x8 /* 0000 1000 */,
+	};
+	
+	enum Ecc(Interrupt) {
+		Ecc(interruptError) = 1,
+		Ecc(interruptTerminate) = 2,
+	};
+	
+	struct Ecc(Env) {
+		jmp_buf buf;
+		struct Context *context;
+		int light;
+		uint32_t profileDepth;
+	};
+	
+	struct Ecc(Patch) {
+		struct Object *object;
+		struct Object content;
 	};
 	
+	#if Ecc(lightjmp)
+		#define io_libecc_ecc_lightSetjmp(env) __builtin_setjmp((void **)(env))
+	#else
+		#define io_libecc_ecc_lightSetjmp(env) setjmp(env)
+	#endif
+	
 	extern uint32_t Ecc(version);
 	
 #endif
@@ -32,30 +58,45 @@
 Interface(Ecc,
 	
 	(struct Ecc *, create ,(void))
+	(struct Ecc *, createWithSnapshot ,(struct Snapshot *))
 	(void, destroy ,(struct Ecc *))
+	(void, reset ,(struct Ecc *))
 	
 	(void, addValue ,(struct Ecc *, const char *name, struct Value value, enum Value(Flags)))
 	(void, addFunction ,(struct Ecc *, const char *name, const Native(Function) native, int argumentCount, enum Value(Flags)))
 	
 	(int, evalInput ,(struct Ecc *, struct Input *, enum Ecc(EvalFlags)))
 	(void, evalInputWithContext ,(struct Ecc *, struct Input *, struct Context *context))
+	(int, callFunction ,(struct Ecc *, struct Function *, struct Value this, struct Object *arguments))
+	(int, compileInput ,(struct Ecc *, struct Input *, const char *filename, enum Ecc(EvalFlags)))
 	
 	(jmp_buf *, pushEnv ,(struct Ecc *))
+	(jmp_buf *, pushLightEnv ,(struct Ecc *))
 	(void, popEnv ,(struct Ecc *))
 	(void, jmpEnv ,(struct Ecc *, struct Value value) Ecc(noreturn))
+	(void, interrupt ,(struct Ecc *, enum Ecc(Interrupt)))
 	(void, fatal ,(const char *format, ...) Ecc(noreturn))
 	
 	(struct Input *, findInput ,(struct Ecc *self, struct Text text))
 	(void, printTextInput ,(struct Ecc *, struct Text text, int fullLine))
 	
 	(void, garbageCollect ,(struct Ecc *))
+	(void, addRoot ,(struct Ecc *, struct Object *))
+	(void, removeRoot ,(struct Ecc *, struct Object *))
+	
+	(void, activate ,(struct Ecc *))
+	(void, unshareObject ,(struct Object *))
+	(void, publishBuiltins ,(struct Ecc *))
 	,
 	{
-		jmp_buf *envList;
+		struct Ecc(Env) *envList;
 		uint16_t envCount;
 		uint16_t envCapacity;
 		
 		struct Function *global;
+		struct Snapshot *snapshot;
+		struct Context * volatile current;
+		volatile sig_atomic_t samplePending;
 		
 		struct Value result;
 		struct Text text;
@@ -66,9 +107,29 @@ Interface(Ecc,
 		struct Input **inputs;
 		uint16_t inputCount;
 		
+		struct Object **roots;
+		uint16_t rootCount;
+		
+		struct Ecc(Patch) *patches;
+		uint16_t patchCount;
+		uint16_t patchCapacity;
+		struct Ecc *nextInstance;
+		
 		int16_t maximumCallDepth;
+		uint32_t maximumSteps;
+		double maximumTime;
+		
+		int32_t stepCountdown;
+		uint32_t stepCount;
+		double timeLimit;
+		volatile sig_atomic_t interruptRequest;
+		
+		uint32_t lazyFunctionCount;
+		uint32_t lazyCompileCount;
+		
 		unsigned printLastThrow:1;
 		unsigned sloppyMode:1;
+		unsigned lazyFunctions:1;
 	}
 )
 
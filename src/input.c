@@ -10,6 +10,14 @@
 #include "input.h"
 
 #include "chars.h"
+#include "bytecode.h"
+
+#if (__unix__ && !__MSDOS__) || (defined(__APPLE__) && defined(__MACH__))
+	#include <sys/mman.h>
+	#define canMap 1
+#else
+	#define canMap 0
+#endif
 
 // MARK: - Private
 
@@ -32,6 +40,14 @@ struct Input * create()
 	return self;
 }
 
+static
+void classify (struct Input *self)
+{
+	// sources are mostly plain ASCII; knowing it upfront lets the lexer skip decoding
+	if (Text.asciiLength(Text.make(self->bytes, self->length)) == (int32_t)self->length)
+		self->flags |= Input(asciiOnly);
+}
+
 static
 void printInput (const char *name, uint16_t line)
 {
@@ -43,6 +59,22 @@ void printInput (const char *name, uint16_t line)
 	Env.printColor(0, Env(bold), " line:%d", line);
 }
 
+static
+void releaseBytecode (struct Input *self)
+{
+	if (!self->bytecode)
+		return;
+	
+	#if canMap
+	munmap((void *)self->bytecode, self->bytecodeSize);
+	#else
+	free((void *)self->bytecode);
+	#endif
+	
+	self->bytecode = NULL;
+	self->bytecodeSize = 0;
+}
+
 // MARK: - Methods
 
 struct Input * createFromFile (const char *filename)
@@ -75,6 +107,7 @@ struct Input * createFromFile (const char *filename)
 	self->length = (uint32_t)fread(self->bytes, sizeof(char), size, file);
 	fclose(file), file = NULL;
 	self->bytes[size] = '\0';
+	classify(self);
 	
 //	FILE *f = fopen("error.txt", "w");
 //	fprintf(f, "%.*s", self->length, self->bytes);
@@ -102,6 +135,7 @@ struct Input * createFromBytes (const char *bytes, uint32_t length, const char *
 	self->bytes = malloc(length + 1);
 	memcpy(self->bytes, bytes, length);
 	self->bytes[length] = '\0';
+	classify(self);
 	
 	return self;
 }
@@ -110,6 +144,7 @@ void destroy (struct Input *self)
 {
 	assert(self);
 	
+	releaseBytecode(self);
 	free(self->attached), self->attached = NULL;
 	free(self->bytes), self->bytes = NULL;
 	free(self->lines), self->lines = NULL;
@@ -232,3 +267,51 @@ struct Value attachValue (struct Input *self, struct Value value)
 	self->attached[self->attachedCount] = value;
 	return value;
 }
+
+int attachBytecode (struct Input *self, const char *filename)
+{
+	struct Bytecode *bytecode = NULL;
+	FILE *file;
+	long size;
+	
+	assert(self);
+	assert(filename);
+	
+	releaseBytecode(self);
+	
+	file = fopen(filename, "rb");
+	if (!file)
+		return 0;
+	
+	if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < (long)sizeof(*bytecode) || size > UINT32_MAX || fseek(file, 0, SEEK_SET))
+	{
+		fclose(file);
+		return 0;
+	}
+	
+	#if canMap
+	bytecode = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	if (bytecode == MAP_FAILED)
+		bytecode = NULL;
+	#else
+	bytecode = malloc(size);
+	if (fread(bytecode, 1, size, file) != (size_t)size)
+		free(bytecode), bytecode = NULL;
+	#endif
+	
+	fclose(file), file = NULL;
+	
+	if (!bytecode)
+		return 0;
+	
+	self->bytecode = bytecode;
+	self->bytecodeSize = (uint32_t)size;
+	
+	if (!Bytecode.isValid(bytecode, self->bytecodeSize, self))
+	{
+		releaseBytecode(self);
+		return 0;
+	}
+	
+	return 1;
+}
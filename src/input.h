@@ -17,6 +17,10 @@
 
 	#include "value.h"
 	#include "env.h"
+	
+	enum Input(Flags) {
+		Input(asciiOnly) = 1 << 0,
+	};
 
 #endif
 
@@ -31,6 +35,7 @@ Interface(Input,
 	(int32_t, findLine, (struct Input *, struct Text text))
 	
 	(struct Value, attachValue, (struct Input *, struct Value value))
+	(int, attachBytecode, (struct Input *, const char *filename))
 	,
 	{
 		char name[FILENAME_MAX];
@@ -44,6 +49,11 @@ Interface(Input,
 		
 		struct Value *attached;
 		uint16_t attachedCount;
+		
+		const struct Bytecode *bytecode;
+		uint32_t bytecodeSize;
+		
+		uint8_t flags;
 	}
 )
 
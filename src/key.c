@@ -16,21 +16,32 @@
 
 // MARK: - Private
 
-static struct Text *keyPool = NULL;
-static uint16_t keyCount = 0;
-static uint16_t keyCapacity = 0;
+static Ecc(threadLocal) struct Text *keyPool = NULL;
+static Ecc(threadLocal) uint16_t keyCount = 0;
+static Ecc(threadLocal) uint16_t keyCapacity = 0;
 
-static char **charsList = NULL;
-static uint16_t charsCount = 0;
+static Ecc(threadLocal) char **charsList = NULL;
+static Ecc(threadLocal) uint16_t charsCount = 0;
 
 struct Key Key(none) = {{{ 0 }}};
 
-#define _(X) struct Key Key(X);
+#define _(X) Ecc(threadLocal) struct Key Key(X);
 io_libecc_key_Keys
 #undef _
 
 // MARK: - Static Members
 
+static
+const char * copyChars (const struct Text text)
+{
+	char *chars = malloc(text.length + 1);
+	memcpy(chars, text.bytes, text.length);
+	chars[text.length] = '\0';
+	charsList = realloc(charsList, sizeof(*charsList) * (charsCount + 1));
+	charsList[charsCount++] = chars;
+	return chars;
+}
+
 static
 struct Key makeWithNumber (uint16_t number)
 {
@@ -60,14 +71,7 @@ struct Key addWithText (const struct Text text, enum Key(Flags) flags)
 		Env.printWarning("Creating identifier '%.*s'; %u identifier(s) left. Using array of length > 0x%x, or negative-integer/floating-point as property name is discouraged", text.length, text.bytes, UINT16_MAX - keyCount, Object(ElementMax));
 	
 	if (flags & Key(copyOnCreate))
-	{
-		char *chars = malloc(text.length + 1);
-		memcpy(chars, text.bytes, text.length);
-		chars[text.length] = '\0';
-		charsList = realloc(charsList, sizeof(*charsList) * (charsCount + 1));
-		charsList[charsCount++] = chars;
-		keyPool[keyCount++] = Text.make(chars, text.length);
-	}
+		keyPool[keyCount++] = Text.make(copyChars(text), text.length);
 	else
 		keyPool[keyCount++] = text;
 	
@@ -124,6 +128,16 @@ struct Key search (const struct Text text)
 	return makeWithNumber(0);
 }
 
+void copyTextsOf (const char *bytes, uint32_t length)
+{
+	uint16_t index;
+	
+	// keys made by the lexer point into their input, which is about to be freed
+	for (index = 0; index < keyCount; ++index)
+		if (keyPool[index].bytes >= bytes && keyPool[index].bytes < bytes + length)
+			keyPool[index].bytes = copyChars(keyPool[index]);
+}
+
 int isEqual (struct Key self, struct Key to)
 {
 	return self.data.integer == to.data.integer;
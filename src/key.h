@@ -47,7 +47,7 @@
 		_( source )\
 		\
 
-	#define _(X) extern struct Key Key(X);
+	#define _(X) extern Ecc(threadLocal) struct Key Key(X);
 	io_libecc_key_Keys
 	#undef _
 
@@ -66,6 +66,7 @@ Interface(Key,
 	(struct Key, makeWithCString ,(const char *cString))
 	(struct Key, makeWithText ,(const struct Text text, enum Key(Flags) flags))
 	(struct Key, search ,(const struct Text text))
+	(void, copyTextsOf ,(const char *bytes, uint32_t length))
 	
 	(int, isEqual, (struct Key, struct Key))
 	(const struct Text *, textOf, (struct Key))
@@ -0,0 +1,550 @@
+//
+//  loop.c
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#define Implementation
+#include "loop.h"
+
+#if __linux__
+	#include <unistd.h>
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+	#define useEpoll 1
+	#define usePoll 0
+#elif (__unix__ && !__MSDOS__) || (defined(__APPLE__) && defined(__MACH__))
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <poll.h>
+	#define useEpoll 0
+	#define usePoll 1
+#else
+	#define useEpoll 0
+	#define usePoll 0
+#endif
+
+#if useEpoll || usePoll
+	#include <pthread.h>
+	#define canThread 1
+#else
+	#define canThread 0
+#endif
+
+// MARK: - Private
+
+struct Loop(Sync) {
+#if canThread
+	pthread_mutex_t mutex;
+#endif
+	int fds[2];
+	int epoll;
+};
+
+static Ecc(threadLocal) struct Loop *threadLoops = NULL;
+
+// MARK: - Static Members
+
+static
+void lock (struct Loop *self)
+{
+	#if canThread
+	pthread_mutex_lock(&self->sync->mutex);
+	#endif
+}
+
+static
+void unlock (struct Loop *self)
+{
+	#if canThread
+	pthread_mutex_unlock(&self->sync->mutex);
+	#endif
+}
+
+static
+void wake (struct Loop *self)
+{
+	#if useEpoll
+	uint64_t one = 1;
+	if (write(self->sync->fds[0], &one, sizeof(one)) < 0)
+		return;
+	#elif usePoll
+	if (write(self->sync->fds[1], "", 1) < 0)
+		return;
+	#endif
+}
+
+static
+void waitEvents (struct Loop *self, double timeout)
+{
+	int milliseconds = timeout < 0? -1: (int)ceil(timeout);
+	
+	#if useEpoll
+	struct epoll_event event;
+	uint64_t count;
+	
+	if (epoll_wait(self->sync->epoll, &event, 1, milliseconds) > 0)
+		if (read(self->sync->fds[0], &count, sizeof(count)) < 0)
+			return;
+	#elif usePoll
+	struct pollfd pollfd = { self->sync->fds[0], POLLIN };
+	char buffer[64];
+	
+	if (poll(&pollfd, 1, milliseconds) > 0)
+		if (read(self->sync->fds[0], buffer, sizeof(buffer)) < 0)
+			return;
+	#else
+	(void)self;
+	(void)milliseconds;
+	#endif
+}
+
+static
+struct Loop * loopOf (struct Context * const context)
+{
+	struct Loop *self;
+	
+	for (self = threadLoops; self; self = self->next)
+		if (self->ecc == context->ecc)
+			return self;
+	
+	Context.typeError(context, Chars.create("no event loop"));
+}
+
+static
+void setArguments (struct Loop *self, uint32_t slot, struct Object *arguments)
+{
+	struct Value *ref = &self->store->element[slot * 2 + 1].value;
+	
+	if (ref->type == Value(objectType))
+		--ref->data.object->referenceCount;
+	
+	// retained so that the expression that scheduled them does not release them
+	if (arguments)
+		++arguments->referenceCount;
+	
+	Object.addElement(self->store, slot * 2 + 1, arguments? Value.object(arguments): Value(undefined), 0);
+}
+
+static
+uint32_t addSlot (struct Loop *self, struct Function *function, struct Object *arguments)
+{
+	uint32_t slot = self->freeCount? self->freeSlots[--self->freeCount]: self->slotCount++;
+	
+	++function->object.referenceCount;
+	Object.addElement(self->store, slot * 2, Value.function(function), 0);
+	Object.addElement(self->store, slot * 2 + 1, Value(undefined), 0);
+	setArguments(self, slot, arguments);
+	
+	return slot;
+}
+
+static
+void removeSlot (struct Loop *self, uint32_t slot)
+{
+	--self->store->element[slot * 2].value.data.function->object.referenceCount;
+	setArguments(self, slot, NULL);
+	
+	Object.deleteElement(self->store, slot * 2);
+	Object.deleteElement(self->store, slot * 2 + 1);
+	
+	self->freeSlots = realloc(self->freeSlots, sizeof(*self->freeSlots) * (self->freeCount + 1));
+	self->freeSlots[self->freeCount++] = slot;
+}
+
+static
+int invoke (struct Loop *self, uint32_t slot)
+{
+	struct Value function = self->store->element[slot * 2].value;
+	struct Value arguments = self->store->element[slot * 2 + 1].value;
+	
+	return Ecc.callFunction(self->ecc, function.data.function, Value(undefined), arguments.type == Value(objectType)? arguments.data.object: NULL);
+}
+
+static
+void pushJob (struct Loop *self, uint32_t slot)
+{
+	if (self->jobCount >= self->jobCapacity)
+	{
+		self->jobCapacity = self->jobCapacity? self->jobCapacity * 2: 8;
+		self->jobs = realloc(self->jobs, sizeof(*self->jobs) * self->jobCapacity);
+	}
+	self->jobs[self->jobCount++] = slot;
+}
+
+static
+int drainJobs (struct Loop *self)
+{
+	int result = EXIT_SUCCESS;
+	uint32_t index, slot;
+	
+	// jobs queued while draining run in the same pass
+	for (index = 0; index < self->jobCount; ++index)
+	{
+		slot = self->jobs[index];
+		result |= invoke(self, slot);
+		removeSlot(self, slot);
+	}
+	
+	self->jobCount = 0;
+	return result;
+}
+
+static
+void addTimer (struct Loop *self, struct Loop(Timer) timer)
+{
+	uint32_t index;
+	
+	if (self->timerCount >= self->timerCapacity)
+	{
+		self->timerCapacity = self->timerCapacity? self->timerCapacity * 2: 8;
+		self->timers = realloc(self->timers, sizeof(*self->timers) * self->timerCapacity);
+	}
+	
+	for (index = self->timerCount; index && self->timers[index - 1].due > timer.due; --index);
+	
+	memmove(self->timers + index + 1, self->timers + index, sizeof(*self->timers) * (self->timerCount - index));
+	self->timers[index] = timer;
+	++self->timerCount;
+}
+
+static
+int removeTimer (struct Loop *self, uint32_t id)
+{
+	uint32_t index;
+	
+	for (index = 0; index < self->timerCount; ++index)
+		if (self->timers[index].id == id)
+		{
+			removeSlot(self, self->timers[index].slot);
+			memmove(self->timers + index, self->timers + index + 1, sizeof(*self->timers) * (self->timerCount - index - 1));
+			--self->timerCount;
+			return 1;
+		}
+	
+	return 0;
+}
+
+static
+int fireTimers (struct Loop *self)
+{
+	int result = EXIT_SUCCESS;
+	double now = Env.currentTime();
+	uint32_t limit = self->timerCount;
+	struct Loop(Timer) timer;
+	
+	// at most the pending timers per pass, so intervals slower than their period can't starve posts
+	while (limit-- && self->timerCount && self->timers[0].due <= now)
+	{
+		timer = self->timers[0];
+		memmove(self->timers, self->timers + 1, sizeof(*self->timers) * --self->timerCount);
+		
+		self->firingId = timer.id;
+		result |= invoke(self, timer.slot);
+		result |= drainJobs(self);
+		
+		// timers that fell due while the callback ran fire in this pass too
+		now = Env.currentTime();
+		
+		// an interval cleared by its own callback resets firingId
+		if (timer.interval && self->firingId == timer.id)
+		{
+			timer.due = now + timer.interval;
+			addTimer(self, timer);
+		}
+		else
+			removeSlot(self, timer.slot);
+		
+		self->firingId = 0;
+	}
+	
+	return result;
+}
+
+static
+int drainPosts (struct Loop *self)
+{
+	int result = EXIT_SUCCESS;
+	struct Loop(Post) *post, *next, *list = NULL;
+	
+	lock(self);
+	post = self->posts;
+	self->posts = NULL;
+	unlock(self);
+	
+	for (; post; post = next)
+	{
+		next = post->next;
+		post->next = list;
+		list = post;
+	}
+	
+	for (post = list; post; post = next)
+	{
+		next = post->next;
+		post->completion(self, post->data);
+		free(post), post = NULL;
+		result |= drainJobs(self);
+	}
+	
+	return result;
+}
+
+static
+struct Value schedule (struct Context * const context, int repeat)
+{
+	struct Loop *self = loopOf(context);
+	struct Value callback = Context.argument(context, 0);
+	struct Object *arguments = NULL;
+	struct Loop(Timer) timer;
+	double delay;
+	int index, count;
+	
+	if (callback.type != Value(functionType))
+		Context.typeError(context, Chars.create("callback is not a function"));
+	
+	delay = Value.toBinary(context, Context.argument(context, 1)).data.binary;
+	if (!(delay > 0))
+		delay = 0;
+	
+	// an interval always lets the loop breathe
+	if (repeat && delay < 1)
+		delay = 1;
+	
+	if ((count = Context.argumentCount(context)) > 2)
+	{
+		arguments = Array.create();
+		for (index = 2; index < count; ++index)
+			Object.addElement(arguments, index - 2, Context.argument(context, index), 0);
+	}
+	
+	timer.id = ++self->timerId;
+	timer.interval = repeat? delay: 0;
+	timer.due = Env.currentTime() + delay;
+	timer.slot = addSlot(self, callback.data.function, arguments);
+	addTimer(self, timer);
+	
+	return Value.binary(timer.id);
+}
+
+static
+struct Value setTimeout (struct Context * const context)
+{
+	return schedule(context, 0);
+}
+
+static
+struct Value setInterval (struct Context * const context)
+{
+	return schedule(context, 1);
+}
+
+static
+struct Value clearTimeout (struct Context * const context)
+{
+	struct Loop *self = loopOf(context);
+	double id = Value.toBinary(context, Context.argument(context, 0)).data.binary;
+	
+	if (id >= 1 && id <= UINT32_MAX)
+	{
+		if (self->firingId == (uint32_t)id)
+			self->firingId = 0;
+		else
+			removeTimer(self, (uint32_t)id);
+	}
+	
+	return Value(undefined);
+}
+
+static
+struct Value queueMicrotask (struct Context * const context)
+{
+	struct Loop *self = loopOf(context);
+	struct Value callback = Context.argument(context, 0);
+	
+	if (callback.type != Value(functionType))
+		Context.typeError(context, Chars.create("callback is not a function"));
+	
+	addJob(self, callback.data.function, NULL);
+	
+	return Value(undefined);
+}
+
+// MARK: - Methods
+
+struct Loop * create (struct Ecc *ecc)
+{
+	struct Loop *self = malloc(sizeof(*self));
+	
+	assert(ecc);
+	
+	*self = Loop.identity;
+	self->ecc = ecc;
+	self->store = Object.create(NULL);
+	Ecc.addRoot(ecc, self->store);
+	
+	self->sync = malloc(sizeof(*self->sync));
+	self->sync->fds[0] = self->sync->fds[1] = self->sync->epoll = -1;
+	
+	#if canThread
+	pthread_mutex_init(&self->sync->mutex, NULL);
+	#endif
+	
+	#if useEpoll
+	{
+		struct epoll_event event = { EPOLLIN };
+		
+		self->sync->fds[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		self->sync->epoll = epoll_create1(EPOLL_CLOEXEC);
+		epoll_ctl(self->sync->epoll, EPOLL_CTL_ADD, self->sync->fds[0], &event);
+	}
+	#elif usePoll
+	if (!pipe(self->sync->fds))
+	{
+		fcntl(self->sync->fds[0], F_SETFL, fcntl(self->sync->fds[0], F_GETFL) | O_NONBLOCK);
+		fcntl(self->sync->fds[1], F_SETFL, fcntl(self->sync->fds[1], F_GETFL) | O_NONBLOCK);
+	}
+	#endif
+	
+	self->next = threadLoops;
+	threadLoops = self;
+	
+	Ecc.addFunction(ecc, "setTimeout", setTimeout, -2, 0);
+	Ecc.addFunction(ecc, "setInterval", setInterval, -2, 0);
+	Ecc.addFunction(ecc, "clearTimeout", clearTimeout, 1, 0);
+	Ecc.addFunction(ecc, "clearInterval", clearTimeout, 1, 0);
+	Ecc.addFunction(ecc, "queueMicrotask", queueMicrotask, 1, 0);
+	
+	return self;
+}
+
+void destroy (struct Loop *self)
+{
+	struct Loop **loop;
+	struct Loop(Post) *post, *next;
+	
+	assert(self);
+	
+	for (loop = &threadLoops; *loop; loop = &(*loop)->next)
+		if (*loop == self)
+		{
+			*loop = self->next;
+			break;
+		}
+	
+	for (post = self->posts; post; post = next)
+	{
+		next = post->next;
+		free(post), post = NULL;
+	}
+	
+	#if useEpoll
+	close(self->sync->epoll);
+	close(self->sync->fds[0]);
+	#elif usePoll
+	close(self->sync->fds[0]);
+	close(self->sync->fds[1]);
+	#endif
+	
+	#if canThread
+	pthread_mutex_destroy(&self->sync->mutex);
+	#endif
+	
+	Ecc.removeRoot(self->ecc, self->store);
+	
+	free(self->sync), self->sync = NULL;
+	free(self->freeSlots), self->freeSlots = NULL;
+	free(self->jobs), self->jobs = NULL;
+	free(self->timers), self->timers = NULL;
+	free(self), self = NULL;
+}
+
+int run (struct Loop *self)
+{
+	int result = EXIT_SUCCESS, pending;
+	double timeout;
+	
+	assert(self);
+	
+	for (;;)
+	{
+		result |= drainJobs(self);
+		result |= drainPosts(self);
+		result |= fireTimers(self);
+		
+		if (self->jobCount)
+			continue;
+		
+		lock(self);
+		pending = self->posts != NULL;
+		unlock(self);
+		
+		if (pending)
+			continue;
+		else if (self->timerCount)
+		{
+			// a timer already overdue must not turn into an infinite wait
+			timeout = self->timers[0].due - Env.currentTime();
+			waitEvents(self, timeout > 0? timeout: 0);
+		}
+		else if (self->holdCount)
+			waitEvents(self, -1);
+		else
+			break;
+	}
+	
+	return result;
+}
+
+void addJob (struct Loop *self, struct Function *function, struct Object *arguments)
+{
+	assert(self);
+	assert(function);
+	
+	pushJob(self, addSlot(self, function, arguments));
+}
+
+uint32_t hold (struct Loop *self, struct Function *callback)
+{
+	assert(self);
+	assert(callback);
+	
+	++self->holdCount;
+	return addSlot(self, callback, NULL) + 1;
+}
+
+void settle (struct Loop *self, uint32_t handle, struct Object *arguments)
+{
+	uint32_t slot = handle - 1;
+	
+	assert(self);
+	assert(handle && slot < self->slotCount);
+	assert(self->holdCount);
+	
+	--self->holdCount;
+	
+	if (arguments)
+		setArguments(self, slot, arguments);
+	
+	pushJob(self, slot);
+}
+
+void post (struct Loop *self, Loop(Completion) completion, void *data)
+{
+	struct Loop(Post) *post = malloc(sizeof(*post));
+	
+	assert(self);
+	assert(completion);
+	
+	post->completion = completion;
+	post->data = data;
+	
+	lock(self);
+	post->next = self->posts;
+	self->posts = post;
+	unlock(self);
+	
+	wake(self);
+}
@@ -0,0 +1,78 @@
+//
+//  loop.h
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#ifndef io_libecc_loop_h
+#ifdef Implementation
+#undef Implementation
+#include __FILE__
+#include "implementation.h"
+#else
+#include "interface.h"
+#define io_libecc_loop_h
+
+	#include "ecc.h"
+	
+	struct Loop;
+	
+	typedef void (* Loop(Completion))(struct Loop *, void *data);
+	
+	struct Loop(Timer) {
+		double due;
+		double interval;
+		uint32_t id;
+		uint32_t slot;
+	};
+	
+	struct Loop(Post) {
+		struct Loop(Post) *next;
+		Loop(Completion) completion;
+		void *data;
+	};
+
+#endif
+
+
+Interface(Loop,
+	
+	(struct Loop *, create ,(struct Ecc *))
+	(void, destroy ,(struct Loop *))
+	
+	(int, run ,(struct Loop *))
+	(void, addJob ,(struct Loop *, struct Function *, struct Object *arguments))
+	
+	(uint32_t, hold ,(struct Loop *, struct Function *callback))
+	(void, settle ,(struct Loop *, uint32_t handle, struct Object *arguments))
+	(void, post ,(struct Loop *, Loop(Completion), void *data))
+	,
+	{
+		struct Ecc *ecc;
+		struct Loop *next;
+		struct Object *store;
+		
+		uint32_t *freeSlots;
+		uint32_t freeCount;
+		uint32_t slotCount;
+		
+		uint32_t *jobs;
+		uint32_t jobCount;
+		uint32_t jobCapacity;
+		
+		struct Loop(Timer) *timers;
+		uint32_t timerCount;
+		uint32_t timerCapacity;
+		uint32_t timerId;
+		uint32_t firingId;
+		
+		uint32_t holdCount;
+		
+		struct Loop(Post) *posts;
+		struct Loop(Sync) *sync;
+	}
+)
+
+#endif
@@ -7,6 +7,18 @@
 //
 
 #include "ecc.h"
+#include "profile.h"
+#include "snapshot.h"
+#include "worker.h"
+#include "loop.h"
+#include "task.h"
+#include "lexer.h"
+#include "pool.h"
+
+#if (__unix__ && !__MSDOS__) || (defined(__APPLE__) && defined(__MACH__))
+	#include <pthread.h>
+	#define TEST_THREADS 1
+#endif
 
 static struct Ecc *ecc;
 
@@ -35,9 +47,45 @@ int main (int argc, const char * argv[])
 		result = runTest(-1);
 	else
 	{
-		struct Object *arguments = Arguments.createWithCList(argc - 2, &argv[2]);
+		struct Object *arguments;
+		struct Input *input;
+		const char *samplePath = NULL, *compilePath = NULL, *cachePath = NULL;
+		int sampleRate = 0;
+		
+		for (; argc > 3; argc -= 2, argv += 2)
+		{
+			if (!strcmp(argv[1], "--profile"))
+				Profile.start(ecc, argv[2], Profile(report));
+			else if (!strcmp(argv[1], "--profile-collapsed"))
+				Profile.start(ecc, argv[2], Profile(collapsed));
+			else if (!strcmp(argv[1], "--sample"))
+				samplePath = argv[2];
+			else if (!strcmp(argv[1], "--sample-rate"))
+				sampleRate = atoi(argv[2]);
+			else if (!strcmp(argv[1], "--compile"))
+				compilePath = argv[2];
+			else if (!strcmp(argv[1], "--cache"))
+				cachePath = argv[2];
+			else
+				break;
+		}
+		
+		if (samplePath)
+			Profile.startSampling(ecc, samplePath, sampleRate);
+		
+		arguments = Arguments.createWithCList(argc - 2, &argv[2]);
 		Ecc.addValue(ecc, "arguments", Value.object(arguments), 0);
-		result = Ecc.evalInput(ecc, Input.createFromFile(argv[1]), Ecc(sloppyMode));
+		input = Input.createFromFile(argv[1]);
+		
+		if (compilePath)
+			result = Ecc.compileInput(ecc, input, compilePath, Ecc(sloppyMode));
+		else
+		{
+			if (input && cachePath)
+				Input.attachBytecode(input, cachePath);
+			
+			result = Ecc.evalInput(ecc, input, Ecc(sloppyMode));
+		}
 	}
 	
 	Ecc.destroy(ecc), ecc = NULL;
@@ -50,7 +98,7 @@ int main (int argc, const char * argv[])
 static int alertUsage (void)
 {
 	const char error[] = "Usage";
-	Env.printError(sizeof(error)-1, error, "libecc [<filename> | --test | --test-verbose | --test-quiet]");
+	Env.printError(sizeof(error)-1, error, "libecc [[--profile | --profile-collapsed | --sample <output>] [--sample-rate <hz>] [--compile | --cache <bytecode>] <filename> | --test | --test-verbose | --test-quiet]");
 	
 	return EXIT_FAILURE;
 }
@@ -91,6 +139,8 @@ static int testVerbosity = 0;
 static int testErrorCount = 0;
 static int testCount = 0;
 static double testTime = 0;
+static const char *testBytecodePath = NULL;
+static enum Ecc(EvalFlags) testEvalFlags = 0;
 
 Ecc(useframe)
 static void test (const char *func, int line, const char *test, const char *expect, const char *text)
@@ -98,9 +148,19 @@ static void test (const char *func, int line, const char *test, const char *expe
 	const char *bytes;
 	uint16_t length;
 	clock_t start = clock();
+	struct Input *input = Input.createFromBytes(test, (uint32_t)strlen(test), "%s:%d", func, line);
 	
 	if (testVerbosity > 0 || !setjmp(*Ecc.pushEnv(ecc)))
-		Ecc.evalInput(ecc, Input.createFromBytes(test, (uint32_t)strlen(test), "%s:%d", func, line), Ecc(stringResult));
+	{
+		if (testBytecodePath)
+		{
+			Ecc.compileInput(ecc, Input.createFromBytes(test, (uint32_t)strlen(test), "%s:%d", func, line), testBytecodePath, 0);
+			Input.attachBytecode(input, testBytecodePath);
+			remove(testBytecodePath);
+		}
+		
+		Ecc.evalInput(ecc, input, Ecc(stringResult) | testEvalFlags);
+	}
 	
 	if (testVerbosity <= 0)
 		Ecc.popEnv(ecc);
@@ -163,6 +223,28 @@ static void test (const char *func, int line, const char *test, const char *expe
 }
 #define test(i, e, t) test(__func__, __LINE__, i, e, t)
 
+static void testAssert (const char *func, int line, int condition, const char *format, ...)
+{
+	char message[256];
+	va_list ap;
+	
+	++testCount;
+	
+	if (condition)
+		return;
+	
+	va_start(ap, format);
+	vsnprintf(message, sizeof(message), format, ap);
+	va_end(ap);
+	
+	++testErrorCount;
+	Env.printColor(Env(red), Env(bold), "[failure]");
+	Env.print(" %s:%d - ", func, line);
+	Env.printColor(0, Env(bold), "%s", message);
+	Env.newline();
+}
+#define testAssert(...) testAssert(__func__, __LINE__, __VA_ARGS__)
+
 static void testLexer (void)
 {
 	test("/*hello", "SyntaxError: unterminated comment"
@@ -197,6 +279,14 @@ static void testLexer (void)
 	,    "^~~~");
 	test("/abc\n""  ", "SyntaxError: unterminated regexp literal"
 	,    "^~~~~" "  ");
+	test("1 /* a comment long enough to be skipped in bulk, with * and / */ + 2", "3", NULL);
+	test("1 /* a comment long enough to be skipped in bulk\n*/ 2", "2", NULL);
+	test("1 // a comment long enough to be skipped in bulk\r\n+ 2", "3", NULL);
+	test("/* comment */ 'a string long enough to be skipped in bulk \\' \"", "SyntaxError: unterminated string literal"
+	,    "              ^~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~");
+	test("'a string long enough to be skipped in bulk \t \\' \" é'.length", "50", NULL);
+	test("var identifierLongEnoughToSkip$_09 = 1; identifierLongEnoughToSkip$_09 + 1", "2", NULL);
+	test("['a\\tb\\x41'.charAt(3), 'a\\u00e9b\\x41'.charAt(2), 'a\\xe9b'.length]", "A,b,3", NULL);
 }
 
 static void testParser (void)
@@ -394,6 +484,10 @@ static void testConvertion (void)
 	,    "            ^~~~~~   ");
 	test("var a = { toString: function () { return this } }, b = ''; b.join[a](b)", "TypeError: cannot convert 'b.join' to object"
 	,    "                                                           ^~~~~~      ");
+	test("var b = []; b['ca' + 'll'](b)", "TypeError: 'b['ca' + 'll']' is not a function"
+	,    "            ^~~~~~~~~~~~~~   ");
+	test("function b() { return 1 } b(2)(3)", "TypeError: 'b(2)' is not a function"
+	,    "                          ^~~~   ");
 }
 
 static void testException (void)
@@ -427,6 +521,8 @@ static void testException (void)
 	test("try { throw 'a' }", "SyntaxError: expected catch or finally, got end of script"
 	,    "                 ^");
 	test("var c = 0; try{ c += 1; } finally{ c *= 2; } c", "2", NULL);
+	test("var c = 0; for (var i = 0; i < 100; ++i) try { if (i % 3) throw i; c += i } catch (e) { c -= e } c", "-1584", NULL);
+	test("var c = 0; [ 3, 1, 2 ].sort(function(a, b){ try { null.a } catch (e) { ++c } return a - b }).join() + (c > 0)", "1,2,3true", NULL);
 }
 
 static void testOperator (void)
@@ -554,6 +650,15 @@ static void testSwitch (void)
 	,    "                        ^~~~~~~     ");
 	test("switch (123) { abc: ; }", "SyntaxError: invalid switch statement"
 	,    "               ^~~     ");
+	test("var r = ''; for (var i = 0; i < 6; ++i) switch (i) { case 4: r += 'd'; break; case 2: r += 'b'; case 3: r += 'c'; break; case 0: r += 'a'; break; default: r += '-' } r", "a-bccd-", NULL);
+	test("var r = ''; for (var i in { b: 0, a: 0, c: 0, d: 0 }) switch (i) { case 'c': r += 3; break; case 'a': r += 1; break; case 'b': r += 2; break; } r", "213", NULL);
+	test("switch ('1') { case 1: 'number'; break; case '1': 'string'; break; }", "string", NULL);
+	test("switch (1) { case '1': 'string'; break; case 1: 'number'; break; }", "number", NULL);
+	test("switch (2) { case 2: 'first'; break; case 1: case 2: 'second'; break; }", "first", NULL);
+	test("switch (-0) { case 1: 1; break; case 0: 0; break; }", "0", NULL);
+	test("switch (NaN) { case NaN: 'nan'; break; case 1: 1; break; default: 'none' }", "none", NULL);
+	test("switch (new String('a')) { case 'a': 'a'; break; case 'b': 'b'; break; default: 'object' }", "object", NULL);
+	test("switch ('ab') { case 'abc': 3; break; case 'a': 1; break; case 'ab': 2; break; }", "2", NULL);
 }
 
 static void testDelete (void)
@@ -687,6 +792,17 @@ static void testFunction (void)
 	test("function a(){ function b(){} return b }; var c = a(), d = a(); c == d", "false", NULL);
 	test("function a(){ function b(){} return b }; var c = a(), d = a(); c.prototype == d.prototype", "false", NULL);
 	test("function a(){ function b(){} return b }; var c = a(), d = a(); c.prototype.constructor == d.prototype.constructor", "false", NULL);
+	test("Math.max(1, 5, 3, 4) + Math.max() + Math.max(2)", "-Infinity", NULL);
+	test("'abc'.charCodeAt() + 'abc'.charCodeAt(1, 2, 3)", "195", NULL);
+	test("var i = 0; 'abc'.charAt(1, ++i, ++i) + i", "b2", NULL);
+	test("Math.max.apply(null, [ 1, 5, 3 ]) + Math.max.call(null, 1, 5, 3)", "10", NULL);
+	test("var f = Math.max.bind(null, 7); f(1, 9) + f()", "16", NULL);
+}
+
+static struct Value testInterrupt (struct Context * const context)
+{
+	Ecc.interrupt(context->ecc, Value.toInteger(context, Context.argument(context, 0)).data.integer);
+	return Value(undefined);
 }
 
 static void testLoop (void)
@@ -716,6 +832,30 @@ static void testLoop (void)
 	test("while (1) break abc;", "SyntaxError: label not found"
 	,    "                ^~~ ");
 	test("var a; do a = 1; while (false); a", "1", NULL);
+	
+	ecc->maximumSteps = 10000;
+	test("var a = 0; for (var i = 0; i < 1000; ++i) ++a; a", "1000", NULL);
+	test("var a = 0; while (1) ++a", "RangeError: step budget exceeded", NULL);
+	test("var a = 0; try { for (;;) ++a } catch (e) { a = -1 } a", "RangeError: step budget exceeded", NULL);
+	test("var a = 0; try { for (;;) ++a } finally { a = -1 } a", "RangeError: step budget exceeded", NULL);
+	test("function f(){ return 1 + f() } try { f() } catch (e) { e }", "RangeError: maximum depth exceeded", NULL);
+	test("function f(n){ return n && f(n - 1) + f(n - 1) } f(20)", "RangeError: step budget exceeded", NULL);
+	ecc->maximumSteps = 0;
+	
+	Ecc.addFunction(ecc, "interrupt", testInterrupt, 1, 0);
+	test("interrupt(1); for (;;);", "RangeError: execution interrupted", NULL);
+	test("var a = 0; try { interrupt(1); for (;;) ++a } catch (e) { a = e } a", "RangeError: execution interrupted", NULL);
+	test("var a = 0; try { interrupt(1); for (;;) ++a } catch (e) { a = -1 } for (var i = 0; i < 5000; ++i) ++a; a", "4999", NULL);
+	test("interrupt(2); for (;;);", "RangeError: execution terminated", NULL);
+	test("var a = 0; try { interrupt(2); for (;;) ++a } catch (e) { a = -1 } a", "RangeError: execution terminated", NULL);
+	test("var a = 0; try { try { interrupt(2); for (;;) ++a } finally { a = -1 } } catch (e) { a = -2 } a", "RangeError: execution terminated", NULL);
+	test("var a = 0; for (var i = 0; i < 5000; ++i) ++a; a", "5000", NULL);
+	
+	ecc->maximumTime = 20;
+	test("for (;;);", "RangeError: time budget exceeded", NULL);
+	test("var a = 0; try { for (;;) ++a } catch (e) { a = -1 } finally { a = -2 } a", "RangeError: time budget exceeded", NULL);
+	test("var a = 0; for (var i = 0; i < 1000; ++i) ++a; a", "1000", NULL);
+	ecc->maximumTime = 0;
 }
 
 static void testThis (void)
@@ -942,6 +1082,7 @@ static void testArray (void)
 	test("var a = [1, 2]; a.length = 5; a.length", "5", NULL);
 	test("var a = [1, 2]; a[5] = 5; a.length", "6", NULL);
 	test("var a = [1, 2]; a.join()", "1,2", NULL);
+	test("var a = [-2147483648, -2147483647, -10, -1, 0, 9, 10, 2147483647, 'abc', 'x'], b = []; for (var i = 0; i < a.length; ++i) b[i] = a[i] + ''; a.join('--') + '|' + b.join(' ')", "-2147483648---2147483647---10---1--0--9--10--2147483647--abc--x|-2147483648 -2147483647 -10 -1 0 9 10 2147483647 abc x", NULL);
 	test("var a = [1, 2]; a.join('abc')", "1abc2", NULL);
 	test("var a = [1, 2], b = ''; b += a.pop(); b += a.pop(); b += a.pop()", "21undefined", NULL);
 	test("var a = [1, 2]; a.push(); a.toString()", "1,2", NULL);
@@ -1038,6 +1179,166 @@ static void testBoolean (void)
 	test("Boolean.prototype.toString(true)", "false", NULL);
 }
 
+static uint64_t testRandom (uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static int testShortestDigits (const char *bytes, char *digits)
+{
+	int length = 0;
+	
+	for (; *bytes && *bytes != 'e'; ++bytes)
+		if (*bytes >= '0' && *bytes <= '9' && (length || *bytes != '0'))
+			digits[length++] = *bytes;
+	
+	while (length && digits[length - 1] == '0')
+		--length;
+	
+	digits[length] = '\0';
+	return length;
+}
+
+static void testLegacyBinary (char *buffer, double binary)
+{
+	uint32_t length;
+	
+	/* number formatting that preceded the shortest round-trip conversion */
+	if (binary <= -1e+21 || binary >= 1e+21)
+		length = sprintf(buffer, "%g", binary);
+	else if ((binary < 1 && binary >= 0.000001) || (binary > -1 && binary <= -0.000001))
+	{
+		length = sprintf(buffer, "%.10f", binary);
+		while (buffer[length - 1] == '0')
+			buffer[--length] = '\0';
+		
+		if (buffer[length - 1] == '.')
+			buffer[--length] = '\0';
+		
+		return;
+	}
+	else
+		length = sprintf(buffer, "%.*g", binary >= -1e15 && binary <= 1e15? DBL_DIG: 21, binary);
+	
+	if (length > 4 && buffer[length - 4] == 'e' && buffer[length - 2] == '0')
+	{
+		buffer[length - 2] = buffer[length - 1];
+		buffer[length - 1] = '\0';
+	}
+}
+
+static struct Value testFormatFailures (struct Context * const context)
+{
+	int32_t index, count = Value.toInteger(context, Context.argument(context, 0)).data.integer, failures = 0;
+	uint64_t state = 0x9e3779b97f4a7c15;
+	char bytes[40], legacy[40], digits[40], expect[40], buffer[40];
+	union { double binary; uint64_t bits; } u;
+	struct Chars(Append) chars;
+	struct Value value;
+	int precision;
+	
+	for (index = 0; index < count * 2; ++index)
+	{
+		// random bit patterns, then short decimals at random scales
+		if (index < count)
+			u.bits = testRandom(&state);
+		else
+		{
+			sprintf(buffer, "%llue%d", (unsigned long long)(testRandom(&state) % 1000000000), (int)(testRandom(&state) % 60) - 30);
+			u.binary = strtod(buffer, NULL);
+		}
+		
+		if (!isfinite(u.binary))
+			continue;
+		
+		Chars.beginAppend(&chars);
+		Chars.appendBinary(&chars, u.binary, 10);
+		value = Chars.endAppend(&chars);
+		sprintf(bytes, "%.*s", Value.stringLength(&value), Value.stringBytes(&value));
+		
+		for (precision = 1; precision <= 17; ++precision)
+		{
+			sprintf(buffer, "%.*e", precision - 1, u.binary);
+			if (strtod(buffer, NULL) == u.binary)
+				break;
+		}
+		
+		testShortestDigits(buffer, expect);
+		testShortestDigits(bytes, digits);
+		testLegacyBinary(legacy, u.binary);
+		
+		if (strtod(bytes, NULL) != u.binary || strcmp(digits, expect) || (strtod(legacy, NULL) == u.binary && strlen(legacy) < strlen(bytes)))
+		{
+			if (failures++ < 10)
+				Env.print("%s: %s, expected digits %s, previously %s\n", __func__, bytes, expect, legacy);
+		}
+	}
+	
+	return Value.integer(failures);
+}
+
+static struct Value testParseFailures (struct Context * const context)
+{
+	int32_t index, count = Value.toInteger(context, Context.argument(context, 0)).data.integer, failures = 0, digits, length;
+	uint64_t state = 0x2545f4914f6cdd1d, integer;
+	char buffer[64];
+	union { double binary; uint64_t bits; } u, expect;
+	
+	for (index = 0; index < count * 4; ++index)
+	{
+		switch (index % 4)
+		{
+			// formatted doubles at every precision
+			case 0:
+				u.bits = testRandom(&state);
+				if (!isfinite(u.binary))
+					continue;
+				
+				length = sprintf(buffer, "%.*g", (int)(testRandom(&state) % 17) + 1, u.binary);
+				break;
+			
+			// random digits with a point and an exponent, some past 19 digits
+			case 1:
+				digits = (int)(testRandom(&state) % 24) + 1;
+				for (length = 0; length < digits; ++length)
+					buffer[length] = '0' + testRandom(&state) % 10;
+				
+				if (testRandom(&state) % 2)
+				{
+					memmove(buffer + digits / 2 + 1, buffer + digits / 2, digits - digits / 2);
+					buffer[digits / 2] = '.';
+					++length;
+				}
+				
+				length += sprintf(buffer + length, "e%d", (int)(testRandom(&state) % 700) - 360);
+				break;
+			
+			// integers exactly halfway between two doubles
+			case 2:
+				digits = (int)(testRandom(&state) % 10) + 1;
+				integer = ((testRandom(&state) >> 11 | UINT64_C(1) << 52) << digits) + (UINT64_C(1) << (digits - 1));
+				length = sprintf(buffer, "%llu", (unsigned long long)integer);
+				break;
+			
+			// near the subnormal and overflow limits
+			case 3:
+				length = sprintf(buffer, "%llue%d", (unsigned long long)(testRandom(&state) % 100000000000000000), (testRandom(&state) % 2? -340: 292) - (int)(testRandom(&state) % 8));
+				break;
+		}
+		
+		u.binary = Lexer.scanBinary(Text.make(buffer, length), 0).data.binary;
+		expect.binary = strtod(buffer, NULL);
+		
+		if (u.bits != expect.bits && failures++ < 10)
+			Env.print("%s: %s read as %.17g, expected %.17g\n", __func__, buffer, u.binary, expect.binary);
+	}
+	
+	return Value.integer(failures);
+}
+
 static void testNumber (void)
 {
 	test("Number", "function Number() [native code]", NULL);
@@ -1086,8 +1387,8 @@ static void testNumber (void)
 	test("(-2147483647).toString(2)", "-1111111111111111111111111111111", NULL);
 	test("2147483647..toString(8)", "17777777777", NULL);
 	test("(-2147483647).toString(8)", "-17777777777", NULL);
-	test("Number.MAX_VALUE.toString(10)", "1.79769e+308", NULL);
-	test("Number.MIN_VALUE.toString(10)", "4.94065645841247e-324", NULL);
+	test("Number.MAX_VALUE.toString(10)", "1.7976931348623157e+308", NULL);
+	test("Number.MIN_VALUE.toString(10)", "5e-324", NULL);
 	test("(2147483647).toString(16)", "7fffffff", NULL);
 	test("(-2147483647).toString(16)", "-7fffffff", NULL);
 	test("-2147483647..toString(16)", "NaN", NULL);
@@ -1107,6 +1408,18 @@ static void testNumber (void)
 	test("Number()", "0", NULL);
 	test("Number(undefined)", "NaN", NULL);
 	test("Math.pow(-1, Infinity)", "NaN", NULL);
+	test("[0.1 + 0.2, 1 / 3, 2 / 3, -0, 100, 1e21, 1e100, 123e-20, 9007199254740993]", "0.30000000000000004,0.3333333333333333,0.6666666666666666,0,100,1e+21,1e+100,1.23e-18,9007199254740992", NULL);
+	test("[123456789012345680000, 1.5e-7, 0.000001, 0.000001234, 1.2345678e-7, 1.2345678e21, -1e-7, 4.35, 0.5e-6]", "123456789012345680000,1.5e-7,0.000001,0.000001234,1.2345678e-7,1.2345678e+21,-1e-7,4.35,5e-7", NULL);
+	test("JSON.stringify([0.1, 1e21, -1.5, 2.5e-8]) + (1.1 + '') + 2.25", "[0.1,1e+21,-1.5,2.5e-8]1.12.25", NULL);
+	
+	Ecc.addFunction(ecc, "formatFailures", testFormatFailures, 1, 0);
+	test("formatFailures(20000)", "0", NULL);
+	
+	Ecc.addFunction(ecc, "parseFailures", testParseFailures, 1, 0);
+	test("parseFailures(20000)", "0", NULL);
+	test("[+'0.1', +'.5', +'5.', +'1e', +'1e+', +'-0', 1 / +'-0', +'0x1A', +'.', +'-', +'1.5e400', +'1e-400', +'00012']", "0.1,0.5,5,NaN,NaN,0,-Infinity,26,NaN,NaN,Infinity,0,12", NULL);
+	test("[+'2.2250738585072011e-308', +'4.9406564584124654e-324', +'2.4703282292062328e-324', +'9007199254740993', +'123456789012345678901234567890']", "2.225073858507201e-308,5e-324,5e-324,9007199254740992,1.2345678901234568e+29", NULL);
+	test("[parseFloat('3.25abc'), parseFloat(' -12e3x'), parseInt('0012'), parseInt('-2147483648'), parseInt('999999999'), parseInt('010')]", "3.25,-12000,12,-2147483648,999999999,10", NULL);
 }
 
 static void testDate (void)
@@ -1311,6 +1624,8 @@ static void testString (void)
 	test("'A<B>bold</B>and<CODE>coded</CODE>'.split(/<(\\/)?([^<>]+)>/)", "A,,B,bold,/,B,and,,CODE,coded,/,CODE,", NULL);
 	test("'ΐßﬓlibecc'.toUpperCase()", "Ϊ́SSՄՆLIBECC", NULL);
 	test("'ẞLIBECCİB'.toLowerCase()", "ßlibecci̇b", NULL);
+	test("for (var n = 0, bad = 0, s = '', p = '@AZ[`az{ 09~\\x7f'; n < 150; ++n) { s += p.charAt(n * 7 % p.length); for (var k = 0; k <= n; k += 13) { var t = s.slice(0, k) + (n % 3? 'É': 'ß𐐷') + s.slice(k), lower = '', upper = ''; for (var i = 0; i < t.length; ++i) { lower += t.charAt(i).toLowerCase(); upper += t.charAt(i).toUpperCase() }; bad += t.toLowerCase() != lower || t.toUpperCase() != upper } }; bad", "0", NULL);
+	test("var s = Array(100).join('Ab'); s.toUpperCase().slice(-5) + s.toLowerCase().slice(0, 5) + (s + 'Ω' + s).toLowerCase().charAt(198) + (s + 'ω' + s).toUpperCase().slice(196, 201)", "BABABababaωABΩAB", NULL);
 	test("var s='abc'; String(s)", "abc", NULL);
 	test("var s='abc'; new String(s)", "abc", NULL);
 	test("var s='abc'; typeof String(s)", "string", NULL);
@@ -1360,10 +1675,37 @@ static void testString (void)
 	test("'uuabc123abc'.replace('abc', function (){ return arguments[1] })", "uu2123abc", NULL);
 	test("'$1,$2'.replace(/(\\$(\\d))/g, '$$1-$1$2')", "$1-$11,$1-$22", NULL);
 	test("'$1,$2'.replace('$1', '$$1-$1$2')", "$1-$1$2,$2", NULL);
+	test("'abcdefghijkl'.replace(/(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)(k)/, '[$11|$12|$10|$1|$01|$0|$$|$&|$`|$\\'|$x|$]')", "[k|a2|j|a|a|$0|$|abcdefghijk||l|$x|$]l", NULL);
+	test("['abc'.replace(/(b)/, '[$2|$1$]'), 'a1b2'.replace(/\\d/g, '$'), 'a1b2'.replace('1', '$$$&$'), 'ab'.replace(/(x)?b/, '[$1]')]", "a[$2|b$]c,a$b$,a$1$b2,a[]", NULL);
+	test("var r = []; 'é1ab2é𝌆3'.replace(/\\d/g, function (m, at) { r.push(at) }); r", "1,4,8", NULL);
+	test("['aéb'.split(/x*/), 'a1b22c'.split(/(\\d)/)].join('|')", "a,é,b|a,1,b,2,,2,c", NULL);
+	test("['abcdef'.replace('cd', \"[$`|$']\"), 'abcdef'.replace(/cd/, \"[$`|$']\"), 'a\\0b\\0c'.replace('b', 'x').length]", "ab[ab|ef]ef,ab[ab|ef]ef,5", NULL);
 	test("' abc  '.trim()", "abc", NULL);
 	test("'\\u00A0 abc  \\u00A0'.trim()", "abc", NULL);
 	test("'\\u2029 abc  \\u2029'.trim()", "abc", NULL);
+	test("[' \\t\\n\\v\\f\\r a b \\r\\n'.trim(), '\\u00A0\\t\\u3000é\\u3000 \\u00A0'.trim(), '\\u2028'.trim().length, 'é '.trim(), ' é'.trim(), 'x'.trim()].join('|')", "a b|é|0|é|é|x", NULL);
 	test("var s = new String('123'); ++s[2]; ++s[2] + s", "4123", NULL);
+	test("this.a = Array(1001).join('ab'); a.charAt(1500) + a.charCodeAt(1999) + a.slice(-3) + a.indexOf('ba', 777) + a.lastIndexOf('ab', 1234) + a.charAt(2000)", "a98bab7771234", NULL);
+	test("this.u = ''; this.codes = []; for (var i = 0; i < 200; ++i) if (i % 3) { u += 'é'; codes.push(0xe9) } else { u += '𐐷'; codes.push(0xd801, 0xdc37) }; u.length + ',' + codes.length", "267,267", NULL);
+	test("for (var i = 0, bad = 0; i < codes.length; ++i) bad += u.charCodeAt(i) != codes[i] || u.charAt(i) != String.fromCharCode(codes[i]) || new String(u)[i] != u.charAt(i); bad", "0", NULL);
+	test("for (var i = 0, bad = 0; i < codes.length; i += 7) bad += u.slice(i, i + 70) != String.fromCharCode.apply(null, codes.slice(i, i + 70)) || u.substring(-i, i) != String.fromCharCode.apply(null, codes.slice(0, i)); bad", "0", NULL);
+	test("u.slice(-2) + u.slice(-4, -2) + u.charAt(266) + u.indexOf('𐐷', 200) + ',' + u.lastIndexOf('é', 200)", "\xED\xB0\xB7""éé\xED\xA0\x81""é200,199", NULL);
+	test("this.boxes = []; for (var i = 0; i < 100; ++i) boxes[i] = Object(u); boxes.length = 1; boxes[0].length + u.slice(0, 2) + a.length", "267𐐷2000", NULL);
+	test("boxes = null; u.length + a.length", "2267", NULL);
+	test("this.big = Array(2001).join('0123456789'); this.tail = big.slice(10); this.mid = big.substring(500, 1500); tail.length + ',' + mid.length + ',' + tail.slice(0, 3) + mid.charAt(999) + ',' + (tail.slice(100) == big.slice(110))", "19990,1000,0129,true", NULL);
+	test("tail.slice(5, 2005).slice(1000).length + tail.slice(5, 2005).slice(1000, 1003) + ('  ' + big + '  ').trim().length", "100056720000", NULL);
+	test("this.rows = Array(101).join(big.slice(0, 100) + '\\n').split('\\n'); rows.length + ',' + rows[3].length + rows[99].slice(-2) + ',' + big.split('5', 3)[2] + ',' + /(?:0123456789)+/.exec(big)[0].length", "101,10089,678901234,2560", NULL);
+	test("this.wide = Array(301).join('é𐐷x'); this.wv = wide.slice(7); wv.length + ',' + wv.charCodeAt(0) + ',' + wv.charCodeAt(1) + ',' + wv.charCodeAt(1192) + ',' + new String(wv).length", "1193,120,233,120,1193", NULL);
+	test("var parts = [], units = [0]; for (var i = 0; i < 500; ++i) { parts.push(['a', 'b', 'ab', '€', '𐐷', 'ba€'][(i * 7 + (i >> 4)) % 6]); units.push(units[i] + parts[i].length) }; var hay = parts.join('');"
+		"function naive (h, n, from, last) { if (last) { for (var i = Math.min(from, h.length - n.length); i >= 0; --i) if (h.substring(i, i + n.length) == n) return i } else for (var i = from; i + n.length <= h.length; ++i) if (h.substring(i, i + n.length) == n) return i; return -1 }"
+		"for (var k = 0, bad = 0, tried = 0; k < 60; ++k) { var n = k % 10 == 9? 'a€€': parts.slice(k * 37 % 480, k * 37 % 480 + k % 8 + 1).join(''), i = units[k * 53 % 500];"
+		"bad += hay.indexOf(n, i) != naive(hay, n, i) || hay.lastIndexOf(n, i) != naive(hay, n, i, 1) || hay.indexOf(n) != naive(hay, n, 0) || hay.lastIndexOf(n) != naive(hay, n, hay.length, 1);"
+		"bad += hay.split(n).join(n) != hay || hay.split(n, 3).length != Math.min(3, hay.split(n).length) || (hay.indexOf(n) >= 0 && hay.replace(n, '<>') != hay.slice(0, hay.indexOf(n)) + '<>' + hay.slice(hay.indexOf(n) + n.length)); tried += hay.indexOf(n) >= 0 }; hay.length + ',' + bad + ',' + tried", "832,0,54", NULL);
+	test("var s = Array(200).join('x') + 'needle' + Array(200).join('x') + 'needle'; s.indexOf('needle') + ',' + s.lastIndexOf('needle') + ',' + s.indexOf('needle', 206) + ',' + s.lastIndexOf('needle', 404) + ',' + s.split('needle').length + ',' + s.indexOf('needlf') + s.replace('needle', '!').length", "199,404,404,404,3,-1405", NULL);
+	test("big = wide = rows = null", "null", NULL);
+	
+	Ecc.garbageCollect(ecc);
+	test("tail.slice(-4) + mid.length + wv.slice(-3) + (tail + wv).length", "67891000𐐷x21183", NULL);
 }
 
 static void testRegExp (void)
@@ -1466,9 +1808,10 @@ static void testJSON (void)
 	,                  "      ^  ");
 	test("JSON.parse('{\"abc\": 123}')", "[object Object]", NULL);
 	test("JSON.parse('{\"abc\": 123.4e-2}').abc", "1.234", NULL);
+	test("var a = JSON.parse('[-0, 0, -12, 2147483647, 2147483648, 12345678901234567890, 1E2, 0.1]'), r = []; for (var i = 0; i < a.length; ++i) r.push(1 / a[i]); r.join()", "-Infinity,Infinity,-0.08333333333333333,4.656612875245797e-10,4.656612873077393e-10,8.100000072900001e-20,0.01,10", NULL);
 	test("JSON.parse('{\"abc\": 123,}').abc", "SyntaxError: expect property name"
 	,                  "            ^");
-	test("JSON.parse('{\"abc\": \"ab\\\\\"c\"}').abc", "ab\\\"c", NULL);
+	test("JSON.parse('{\"abc\": \"ab\\\\\"c\"}').abc", "ab\"c", NULL);
 	test("JSON.parse('{\"abc\": [0,1,2,3]}').abc", "0,1,2,3", NULL);
 	test("JSON.parse('{\"abc\": [false,true,null]}').abc", "false,true,", NULL);
 	test("JSON.parse('{\"abc\": [0,1,2,3]}', function(k,v){ return typeof v == 'number'? v * 2: v }).abc", "0,2,4,6", NULL);
@@ -1477,11 +1820,442 @@ static void testJSON (void)
 	test("JSON.stringify({ uno: 1, dos: { tres: 123 } }, null, '  ')", "{\n  \"uno\": 1,\n  \"dos\": {\n    \"tres\": 123\n  }\n}", NULL);
 	test("JSON.stringify({ uno: 1, dos: { tres: 123 } }, null, 3)", "{\n   \"uno\": 1,\n   \"dos\": {\n      \"tres\": 123\n   }\n}", NULL);
 	test("JSON.stringify({ uno: 1, dos: { tres: 123 } })", "{\"uno\":1,\"dos\":{\"tres\":123}}", NULL);
+	test("JSON.stringify([[], {}, [-7, [8]], { a: 'b\\tc\\u001f\\\\' }], null, 1)", "[\n [\n\n ],\n {\n\n },\n [\n  -7,\n  [\n   8\n  ]\n ],\n {\n  \"a\": \"b\\tc\\u001f\\\\\"\n }\n]", NULL);
 	test("var r=''; JSON.stringify({ uno: 1, dos: { tres: 123 } }, function(key,value){ r+=key; return value }); r", "unodostres", NULL);
 	test("JSON.stringify({f:'M',w:4,t:'c',M:7}, function replacer(key,value){ return typeof value=='string'?undefined:value });", "{\"w\":4,\"M\":7}", NULL);
 	test("JSON.stringify({f:'M',w:4,t:'c',M:7}, ['w','M']);", "{\"w\":4,\"M\":7}", NULL);
+	test("JSON.stringify(['a', { b: 'c\\n\"\\u0001' }, 1/0, NaN])", "[\"a\",{\"b\":\"c\\n\\\"\\u0001\"},null,null]", NULL);
+	test("var o = JSON.parse('{\"k\\\\\"\":\"a\\\\\"b\\\\n\\\\u0041\"}'); Object.keys(o)[0] + o['k\"']", "k\"a\"b\nA", NULL);
 }
 
+static void testBytecode (void)
+{
+	testBytecodePath = "libecc-test.bytecode";
+	
+	test("var a = 1, b = 'x\\ty'; a + b", "1x\ty", NULL);
+	test("function f(n) { return n < 2? n: f(n - 1) + f(n - 2) } f(15)", "610", NULL);
+	test("var f = function g(a, b) { return typeof g + a + b + arguments.length }; f(1, 2)", "function122", NULL);
+	test("try { throw 3 } catch (e) { (function(){ return e * 2 })() }", "6", NULL);
+	test("function f(v) { switch (v) { case 1: return 'a'; case 'b': return 'b'; case 3.5: return 'c' } } f(1) + f('b') + f(3.5) + f(4)", "abcundefined", NULL);
+	test("/a+(b)/.exec('xaab')[1]", "b", NULL);
+	test("var o = { get x() { return 2 }, y: [1, 'z'] }; o.x + o.y", "21,z", NULL);
+	test("toString === Object.prototype.toString", "true", NULL);
+	test("var o = {}; o.x.y", "TypeError: cannot convert 'o.x' to object"
+	,    "            ^~~");
+	
+	testBytecodePath = NULL;
+}
+
+static void testLazyFunction (void)
+{
+	uint32_t lazyFunctionCount = ecc->lazyFunctionCount, lazyCompileCount = ecc->lazyCompileCount;
+	
+	testEvalFlags = Ecc(lazyFunctions);
+	
+	test("function f(n) { return n < 2? n: f(n - 1) + f(n - 2) } f(15)", "610", NULL);
+	test("function make(n) { return function() { return n++ } } var a = make(1), b = make(10); a() + a() + b()", "13", NULL);
+	test("var f = function g(a, b) { return typeof g + a + b + arguments.length }; f(1, 2, 3)", "function123", NULL);
+	test("function f() { 'use strict'; return this } typeof f()", "undefined", NULL);
+	test("function f() { return /[})]/.test('}') && [1, { a: '(' }].length / 2 } f()", "1", NULL);
+	test("[3, 1, 2].sort(function(a, b) { return a - b }).join()", "1,2,3", NULL);
+	test("JSON.stringify({ a: 1, b: 2 }, function(k, v) { return v === 2? undefined: v })", "{\"a\":1}", NULL);
+	test("function f() { return 1 +} typeof f", "function", NULL);
+	test("function f() { return 1 +} try { f() } catch (e) { e }", "SyntaxError: expected expression, got '}'", NULL);
+	test("function f() { return (] }", "SyntaxError: expected ')', got ']'"
+	,    "                       ^");
+	
+	testEvalFlags = Ecc(lazyFunctions) | Ecc(sloppyMode);
+	test("var sloppyLazy = function() { var \\u0061b = 1; return ab }; typeof sloppyLazy", "function", NULL);
+	testEvalFlags = Ecc(lazyFunctions);
+	test("sloppyLazy()", "1", NULL);
+	
+	testEvalFlags = 0;
+	
+	testAssert(ecc->lazyFunctionCount - lazyFunctionCount == 12 && ecc->lazyCompileCount - lazyCompileCount == 9, "expect 12 lazy functions, 9 compiled, was %u, %u", ecc->lazyFunctionCount - lazyFunctionCount, ecc->lazyCompileCount - lazyCompileCount);
+}
+
+static void testSnapshot (void)
+{
+	struct Ecc *origin = ecc;
+	struct Snapshot *snapshot;
+	
+	const char bootstrap[] = "var counter = 0, list = [1, 2], re = /b+/g; function bump() { return ++counter }";
+	
+	Ecc.evalInput(ecc, Input.createFromBytes(bootstrap, sizeof(bootstrap) - 1, "bootstrap"), Ecc(sloppyMode));
+	snapshot = Snapshot.createFromEcc(ecc);
+	
+	ecc = Ecc.createWithSnapshot(snapshot);
+	test("bump() + bump() + ',' + list.push(3) + ',' + re.exec('abbc') + ',' + re.lastIndex", "3,3,bb,3", NULL);
+	test("counter + ',' + list + ',' + (this.bump === bump)", "2,1,2,3,true", NULL);
+	test("list.x.y", "TypeError: cannot convert 'list.x' to object"
+	,    "^~~~~~  ");
+	Ecc.destroy(ecc);
+	
+	ecc = Ecc.createWithSnapshot(snapshot);
+	test("bump() + ',' + list + ',' + re.lastIndex", "1,1,2,0", NULL);
+	Ecc.destroy(ecc);
+	
+	Snapshot.destroy(snapshot);
+	ecc = origin;
+	test("counter + ',' + list", "0,1,2", NULL);
+}
+
+static void testSharedBuiltins (void)
+{
+	struct Ecc *origin = ecc, *other = Ecc.create();
+	
+	test("Array.prototype.total = function () { for (var i = 0, t = 0; i < this.length; ++i) t += this[i]; return t }; Object.prototype.tag = 'a'; [1, 2, 3].total() + ({}).tag", "6a", NULL);
+	
+	ecc = other;
+	test("typeof [].total + ',' + ({}).tag + ',' + Object.keys(Array.prototype).length", "undefined,undefined,0", NULL);
+	test("Object.prototype.tag = 'b'; String.prototype.shout = function () { return this.toUpperCase() }; ({}).tag + 'x'.shout()", "bX", NULL);
+	test("Object.freeze(Math); Object.isFrozen(Math)", "true", NULL);
+	
+	ecc = origin;
+	test("[4, 5].total() + ({}).tag + typeof ''.shout + Object.isFrozen(Math)", "9aundefinedfalse", NULL);
+	
+	ecc = other;
+	test("({}).tag + 'y'.shout() + typeof [].total", "bYundefined", NULL);
+	Ecc.destroy(other);
+	
+	ecc = origin;
+	test("delete Array.prototype.total && delete Object.prototype.tag; typeof [].total + typeof ({}).tag", "undefinedundefined", NULL);
+	test("var o = { shout: 1 }; o.shout + Object.keys(o)[0]", "1shout", NULL);
+}
+
+static void testRope (void)
+{
+	test("this.s = ''; for (var i = 0; i < 1000; ++i) s += 'abcdefghij'; s.length + ',' + s.slice(0, 12) + ',' + s.slice(-3) + ',' + s.indexOf('jab')", "10000,abcdefghijab,hij,9", NULL);
+	test("this.t = s; s += '!'; t.length + ',' + s.length + ',' + (t + '!' == s) + ',' + (s + 'a' === s + 'a')", "10000,10001,true,true", NULL);
+	test("(s + 1).slice(-2) + (1 + s).slice(0, 2) + ('' + s).length", "!11a10001", NULL);
+	test("this.p = ''; for (var i = 0; i < 300; ++i) p = i % 10 + p; p.length + p.slice(0, 5)", "30098765", NULL);
+	test("this.h = Array(300).join('x') + '\\uD801'; (h + '\\uDC37xyz').slice(299) + (h + '\\uDC37xyz').length", "𐐷xyz304", NULL);
+	test("this.r = h + ('\\uDC37' + Array(300).join('y')); r.length + r.slice(299, 301)", "600𐐷", NULL);
+	test("this.o = {}; o[s + 'k'] = 1; o[s + 'k'] + ',' + new String(s + s).length", "1,20002", NULL);
+	
+	Ecc.garbageCollect(ecc);
+	test("s.length + s.slice(9990, 9995) + t.slice(-2) + p.slice(-3)", "10001abcdeij210", NULL);
+}
+
+#if PROFILE
+static unsigned long long testProfileCount (const char *report, const char *name)
+{
+	unsigned long long count = 0;
+	const char *found;
+	char needle[64];
+	
+	snprintf(needle, sizeof(needle), "%%  %s\n", name);
+	found = strstr(report, needle);
+	if (found)
+	{
+		while (found > report && found[-1] != '\n')
+			--found;
+		
+		sscanf(found, "%llu", &count);
+	}
+	return count;
+}
+
+static void testProfile (void)
+{
+	const char path[] = "ecc-profile-test.txt";
+	const char script[] =
+		"function f(i) {\n"
+		"	if (i % 2)\n"
+		"		throw i;\n"
+		"	return 1;\n"
+		"}\n"
+		"for (var i = 0, n = 0; i < 10; ++i)\n"
+		"	try { n += f(i) } catch (e) { n += 2 }\n"
+		"n\n";
+	char report[8192] = { 0 };
+	FILE *file;
+	
+	Profile.start(ecc, path, Profile(report));
+	Ecc.evalInput(ecc, Input.createFromBytes(script, sizeof(script) - 1, "profile"), 0);
+	Profile.stop(ecc);
+	
+	file = fopen(path, "r");
+	if (file)
+	{
+		fread(report, 1, sizeof(report) - 1, file);
+		fclose(file), file = NULL;
+		remove(path);
+	}
+	
+	// ops a throw jumps out of are counted too
+	testAssert(testProfileCount(report, "call") == 10 && testProfileCount(report, "throw") == 5, "expect 10 calls and 5 throws, got %llu and %llu", testProfileCount(report, "call"), testProfileCount(report, "throw"));
+	testAssert(testProfileCount(report, "profile:2") == 40 && testProfileCount(report, "profile:7") == 135, "expect 40 and 135 ops on lines 2 and 7, got %llu and %llu", testProfileCount(report, "profile:2"), testProfileCount(report, "profile:7"));
+}
+#endif
+
+static void testEventLoop (void)
+{
+	struct Loop *loop = Loop.create(ecc);
+	
+	test("var i = 0, h; this.log = []; setTimeout(function () { log.push('z') }, 0);"
+		"h = setInterval(function () { log.push('i' + ++i); if (i == 3) clearInterval(h) }, 1);"
+		"setTimeout(function (a, b) { log.push('t' + a + b); queueMicrotask(function () { log.push('tm') }) }, 100, 1, 2);"
+		"queueMicrotask(function () { log.push('m') }); clearTimeout(setTimeout(function () { log.push('never') }, 1)); log.length", "0", NULL);
+	
+	testAssert(Loop.run(loop) == EXIT_SUCCESS, "expect the loop to succeed");
+	
+	test("log.join()", "m,z,i1,i2,i3,t12,tm", NULL);
+	
+	test("this.log = []; setTimeout(function () { var t = Date.now(); while (Date.now() - t < 20); log.push('slow') }, 0);"
+		"setTimeout(function () { log.push('due') }, 5); setTimeout(function () { log.push('later') }, 40); log.length", "0", NULL);
+	
+	testAssert(Loop.run(loop) == EXIT_SUCCESS, "expect the loop to return after an overdue timer");
+	
+	test("log.join()", "slow,due,later", NULL);
+	test("setTimeout(1)", "TypeError: callback is not a function", NULL);
+	
+	Loop.destroy(loop);
+	test("setTimeout(function(){})", "TypeError: no event loop", NULL);
+}
+
+#if TEST_THREADS
+
+struct TestRequest {
+	pthread_t thread;
+	struct Loop *loop;
+	uint32_t handle;
+	int value;
+};
+
+static struct TestRequest testRequest;
+
+static void testRequestComplete (struct Loop *loop, void *data)
+{
+	struct TestRequest *request = data;
+	struct Object *arguments = Array.create();
+	
+	pthread_join(request->thread, NULL);
+	Object.addElement(arguments, 0, Value.integer(request->value), 0);
+	Loop.settle(loop, request->handle, arguments);
+}
+
+static void * testRequestRun (void *data)
+{
+	struct TestRequest *request = data;
+	
+	request->value *= 2;
+	Loop.post(request->loop, testRequestComplete, request);
+	return NULL;
+}
+
+static struct Value testHostRequest (struct Context * const context)
+{
+	testRequest.value = Value.toInteger(context, Context.argument(context, 0)).data.integer;
+	testRequest.handle = Loop.hold(testRequest.loop, Context.argument(context, 1).data.function);
+	pthread_create(&testRequest.thread, NULL, testRequestRun, &testRequest);
+	return Value(undefined);
+}
+
+static void testLoopThreads (void)
+{
+	testRequest.loop = Loop.create(ecc);
+	Ecc.addFunction(ecc, "hostRequest", testHostRequest, 2, 0);
+	
+	test("this.result = undefined; hostRequest(21, function (value) { result = value; setTimeout(function () { result += '!' }, 1) }); this.result", "undefined", NULL);
+	Loop.run(testRequest.loop);
+	test("result", "42!", NULL);
+	
+	Loop.destroy(testRequest.loop);
+}
+
+static struct Task *testTasks[64];
+static int testTaskCount;
+
+static struct Value testSpawn (struct Context * const context)
+{
+	struct Object *arguments = Array.create();
+	
+	Object.addElement(arguments, 0, Context.argument(context, 1), 0);
+	testTasks[testTaskCount++] = Task.create(context->ecc, Context.argument(context, 0).data.function, Value(undefined), arguments, 0);
+	return Value(undefined);
+}
+
+static struct Value testFetch (struct Context * const context)
+{
+	return Task.suspend(context);
+}
+
+static void testTask (void)
+{
+	int index, failed = 0;
+	uint32_t early[3], late[3];
+	
+	Ecc.addFunction(ecc, "spawn", testSpawn, 2, 0);
+	Ecc.addFunction(ecc, "fetch", testFetch, 0, 0);
+	
+	test("this.log = []; for (var i = 0; i < 50; ++i) spawn(function (n) {"
+		"var a = [n, fetch()]; try { fetch() } catch (e) { a[2] = e } a = a.concat(fetch()).join(''); log[log.length] = a }, i); log.length", "0", NULL);
+	
+	for (index = 0; index < testTaskCount; ++index)
+		failed |= Task.resume(testTasks[index], Value(undefined)) != Task(suspended);
+	
+	for (index = testTaskCount; index--;)
+		failed |= Task.resume(testTasks[index], Value.chars(Chars.create("<%d>", index))) != Task(suspended);
+	
+	test("log.length", "0", NULL);
+	
+	for (index = 0; index < testTaskCount; ++index)
+		failed |= Task.resumeThrowing(testTasks[index], Value.integer(7)) != Task(suspended);
+	
+	for (index = testTaskCount; index--;)
+	{
+		failed |= Task.resume(testTasks[index], Value.integer(index * 2)) != Task(done);
+		Task.destroy(testTasks[index]);
+	}
+	
+	testAssert(!failed, "expect tasks to suspend and complete");
+	
+	test("log.length + ',' + log[0] + ',' + log[49]", "50,49<49>798,0<0>70", NULL);
+	test("fetch()", "TypeError: cannot suspend outside of a task", NULL);
+	
+	testTaskCount = 0;
+	test("spawn(function () { try { fetch() } catch (e) { log = 'caught' } log = 'resumed' })", "undefined", NULL);
+	Task.resume(testTasks[0], Value(undefined));
+	Task.destroy(testTasks[0]);
+	test("log.length", "50", NULL);
+	testTaskCount = 0;
+	
+	test("spawn(function () { var o = { text: 'kept' }; for (var i = 0; i < 200; ++i) o.text = [o.text.slice(0, 4), fetch(), i].join(' '); log = o.text })", "undefined", NULL);
+	Task.resume(testTasks[0], Value(undefined));
+	for (index = 0; index < 200; ++index)
+	{
+		Ecc.garbageCollect(ecc);
+		if (index == 20)
+			Pool.getIndices(early);
+		
+		failed |= Task.resume(testTasks[0], Value.chars(Chars.create("<%d>", index))) != (index < 199? Task(suspended): Task(done));
+	}
+	Ecc.garbageCollect(ecc);
+	Pool.getIndices(late);
+	Task.destroy(testTasks[0]);
+	testTaskCount = 0;
+	
+	testAssert(!failed, "expect a long task to suspend and complete");
+	testAssert(late[1] <= early[1] && late[2] <= early[2], "expect a long task not to grow the pool, %u objects %u chars became %u %u", early[1], early[2], late[1], late[2]);
+	test("log", "kept <199> 199", NULL);
+}
+
+struct TestThread {
+	pthread_t thread;
+	int failureCount;
+	char result[64];
+};
+
+static void * testThreadRun (void *data)
+{
+	struct TestThread *self = data;
+	struct Ecc *instance = Ecc.create();
+	int iteration;
+	
+	const char expect[] = "610,200,200,42|42,123";
+	const char script[] =
+		"var o = {}, s = ''; for (var i = 0; i < 200; ++i) { o['k' + i] = [i, String(i)]; s += i % 10 }"
+		"function fib(n) { return n < 2? n: fib(n - 1) + fib(n - 2) }"
+		"fib(15) + ',' + Object.keys(o).length + ',' + s.length + ',' + o.k42.join('|') + ',' + /\\d+/.exec('ab123')";
+	
+	for (iteration = 0; iteration < 20; ++iteration)
+	{
+		Ecc.evalInput(instance, Input.createFromBytes(script, sizeof(script) - 1, "thread"), Ecc(stringResult));
+		
+		if (Value.stringLength(&instance->result) != sizeof(expect) - 1 || memcmp(expect, Value.stringBytes(&instance->result), sizeof(expect) - 1))
+			++self->failureCount;
+		
+		snprintf(self->result, sizeof(self->result), "%.*s", Value.stringLength(&instance->result), Value.stringBytes(&instance->result));
+		Ecc.garbageCollect(instance);
+	}
+	
+	Ecc.destroy(instance);
+	return NULL;
+}
+
+static void testThreads (void)
+{
+	struct TestThread threads[8] = {{ 0 }};
+	int index, count = sizeof(threads) / sizeof(*threads);
+	
+	for (index = 0; index < count; ++index)
+		pthread_create(&threads[index].thread, NULL, testThreadRun, &threads[index]);
+	
+	for (index = 0; index < count; ++index)
+	{
+		pthread_join(threads[index].thread, NULL);
+		testAssert(!threads[index].failureCount, "thread %d failed %d times, last result \"%s\"", index, threads[index].failureCount, threads[index].result);
+	}
+	
+	test("typeof Object.prototype.toString", "function", NULL);
+}
+
+static void testJob (const char *func, int line, struct Worker *worker, struct Worker(Job) *job, enum Worker(State) state, const char *expect)
+{
+	enum Worker(State) result = Worker.wait(worker, job);
+	
+	(testAssert)(func, line, result == state && job->resultLength == strlen(expect) && !memcmp(expect, job->result, job->resultLength), "expect %d \"%s\" was %d \"%.*s\"", state, expect, result, job->resultLength, job->result);
+}
+#define testJob(...) testJob(__func__, __LINE__, ##__VA_ARGS__)
+
+static void testWorker (void)
+{
+	const char square[] = "({ n: arguments[0], square: arguments[0] * arguments[0], text: 'a\"b' })";
+	const char forever[] = "for (;;);";
+	struct Worker *worker = Worker.create(2, 2);
+	struct Worker(Job) *jobs[4], *error, *timeout, *running, *queued;
+	struct Context context = { .ecc = ecc };
+	int index;
+	
+	for (index = 0; index < 4; ++index)
+	{
+		char arguments[16];
+		snprintf(arguments, sizeof(arguments), "[%d]", index + 2);
+		jobs[index] = Worker.submit(worker, Input.createFromBytes(square, sizeof(square) - 1, "square"), arguments, 0);
+	}
+	error = Worker.submit(worker, Input.createFromBytes("var = 1", 7, "error"), NULL, 0);
+	timeout = Worker.submit(worker, Input.createFromBytes(forever, sizeof(forever) - 1, "forever"), NULL, 20);
+	
+	testJob(worker, jobs[0], Worker(done), "{\"n\":2,\"square\":4,\"text\":\"a\\\"b\"}");
+	testJob(worker, jobs[3], Worker(done), "{\"n\":5,\"square\":25,\"text\":\"a\\\"b\"}");
+	testJob(worker, error, Worker(failed), "SyntaxError: expected identifier, got '='");
+	testJob(worker, timeout, Worker(timeout), "RangeError: time budget exceeded");
+	
+	Ecc.addValue(ecc, "workerResult", Worker.result(&context, jobs[1]), 0);
+	test("workerResult.square + workerResult.text", "9a\"b", NULL);
+	
+	for (index = 0; index < 4; ++index)
+		Worker.release(jobs[index]);
+	
+	Worker.release(error);
+	Worker.release(timeout);
+	Worker.destroy(worker);
+	
+	worker = Worker.create(1, 1);
+	running = Worker.submit(worker, Input.createFromBytes(forever, sizeof(forever) - 1, "forever"), NULL, 50);
+	queued = Worker.submit(worker, Input.createFromBytes("1 + 1", 5, "queued"), NULL, 0);
+	
+	testAssert(!Worker.trySubmit(worker, Input.createFromBytes("1 + 2", 5, "rejected"), NULL, 0), "expect a full queue to reject the job");
+	
+	testJob(worker, running, Worker(timeout), "RangeError: time budget exceeded");
+	testJob(worker, queued, Worker(done), "2");
+	
+	Worker.release(running);
+	Worker.release(queued);
+	
+	running = Worker.submit(worker, Input.createFromBytes("var leak = 1; Array.prototype.leak = 2; [].leak", 47, "leak"), NULL, 0);
+	testJob(worker, running, Worker(done), "2");
+	queued = Worker.submit(worker, Input.createFromBytes("['leak' in this, 'leak' in []]", 30, "reset"), NULL, 0);
+	testJob(worker, queued, Worker(done), "[false,false]");
+	
+	Worker.release(running);
+	Worker.release(queued);
+	Worker.destroy(worker);
+}
+
+#endif
+
 static int runTest (int verbosity)
 {
 	testVerbosity = verbosity;
@@ -1513,6 +2287,22 @@ static int runTest (int verbosity)
 	testString();
 	testRegExp();
 	testJSON();
+	testBytecode();
+	testLazyFunction();
+	testSnapshot();
+	testSharedBuiltins();
+	testRope();
+	#if PROFILE
+	testProfile();
+	#endif
+	testEventLoop();
+	
+	#if TEST_THREADS
+	testThreads();
+	testWorker();
+	testLoopThreads();
+	testTask();
+	#endif
 	
 	Env.newline();
 	
@@ -25,6 +25,26 @@
 #define             io_libecc_Parser(X) \
                     io_libecc_parser_## X
 
+#define Bytecode    io_libecc_Bytecode
+#define             io_libecc_Bytecode(X) \
+                    io_libecc_bytecode_## X
+
+#define Snapshot    io_libecc_Snapshot
+#define             io_libecc_Snapshot(X) \
+                    io_libecc_snapshot_## X
+
+#define Worker      io_libecc_Worker
+#define             io_libecc_Worker(X) \
+                    io_libecc_worker_## X
+
+#define Loop        io_libecc_Loop
+#define             io_libecc_Loop(X) \
+                    io_libecc_loop_## X
+
+#define Task        io_libecc_Task
+#define             io_libecc_Task(X) \
+                    io_libecc_task_## X
+
 #define Value       io_libecc_Value
 #define             io_libecc_Value(X) \
                     io_libecc_value_## X
@@ -57,6 +77,10 @@
 #define             io_libecc_Pool(X) \
                     io_libecc_pool_## X
 
+#define Profile     io_libecc_Profile
+#define             io_libecc_Profile(X) \
+                    io_libecc_profile_## X
+
 #define Env         io_libecc_Env
 #define             io_libecc_Env(X) \
                     io_libecc_env_## X
@@ -11,13 +11,24 @@
 
 #include "ecc.h"
 #include "oplist.h"
+#include "parser.h"
 #include "pool.h"
+#include "profile.h"
 
 // MARK: - Private
 
-#define nextOp() (++context->ops)->native(context)
+#if PROFILE
+	#define nextOp() Profile.op(context, ++context->ops)
+#else
+	#define nextOp() (++context->ops)->native(context)
+#endif
 #define opValue() (context->ops)->value
 #define opText(O) &(context->ops + O)->text
+#define stepBudget() if (--context->ecc->stepCountdown <= 0) checkBudget(context)
+
+enum {
+	budgetInterval = 1024,
+};
 
 #if DEBUG
 
@@ -145,6 +156,37 @@ int integerWontOverflowNegative(int32_t a, int32_t negative)
 	return a >= INT32_MIN - negative;
 }
 
+static
+struct Value caseValue (const struct Op *op)
+{
+	return op->native == Op.text? Value.text(&op->text): op->value;
+}
+
+static
+double caseBinary (struct Value value)
+{
+	return value.type == Value(integerType)? value.data.integer: value.data.binary;
+}
+
+static
+int compareCase (struct Value a, struct Value b)
+{
+	if (Value.isNumber(a) && Value.isNumber(b))
+	{
+		double aBinary = caseBinary(a), bBinary = caseBinary(b);
+		return aBinary < bBinary? -1: aBinary > bBinary? 1: 0;
+	}
+	else if (Value.isString(a) && Value.isString(b))
+	{
+		int32_t aLength = Value.stringLength(&a);
+		int32_t bLength = Value.stringLength(&b);
+		int result = memcmp(Value.stringBytes(&a), Value.stringBytes(&b), aLength < bLength? aLength: bLength);
+		return result? result: aLength - bLength;
+	}
+	else
+		return Value.isNumber(a)? -1: 1;
+}
+
 // MARK: - Static Members
 
 // MARK: - Methods
@@ -166,7 +208,7 @@ const char * toChars (const Native(Function) native)
 	#undef _
 	
 	int index;
-	for (index = 0; index < sizeof(functionList); ++index)
+	for (index = 0; index < sizeof(functionList) / sizeof(*functionList); ++index)
 		if (functionList[index].native == native)
 			return functionList[index].name;
 	
@@ -174,6 +216,27 @@ const char * toChars (const Native(Function) native)
 	return "unknow";
 }
 
+void sortCases (struct Op *cases, int32_t count)
+{
+	int32_t index, insert;
+	struct Op value, offset;
+	
+	for (index = 1; index < count; ++index)
+	{
+		value = cases[index * 2];
+		offset = cases[index * 2 + 1];
+		
+		for (insert = index; insert > 0 && compareCase(caseValue(&cases[insert * 2 - 2]), caseValue(&value)) > 0; --insert)
+		{
+			cases[insert * 2] = cases[insert * 2 - 2];
+			cases[insert * 2 + 1] = cases[insert * 2 - 1];
+		}
+		
+		cases[insert * 2] = value;
+		cases[insert * 2 + 1] = offset;
+	}
+}
+
 // MARK: call
 
 static
@@ -194,9 +257,67 @@ struct Value replaceRefValue (struct Value *ref, struct Value value)
 	return value;
 }
 
+Ecc(noreturn)
+static
+void budgetError (struct Context * const context, const char *message)
+{
+	const struct Op *op = context->ops;
+	
+	while (!op->text.length && !(op->text.flags & Text(breakFlag)))
+		--op;
+	
+	if (op->text.length && op->text.bytes != Text(nativeCode).bytes)
+		Context.setText(context, &op->text);
+	
+	Context.rangeError(context, Chars.create("%s", message));
+}
+
+static
+void checkBudget (struct Context * const context)
+{
+	struct Ecc *ecc = context->ecc;
+	uint32_t steps = budgetInterval;
+	
+	if (ecc->samplePending)
+		Profile.drainSamples(ecc);
+	
+	if (ecc->interruptRequest == Ecc(interruptError))
+	{
+		ecc->interruptRequest = 0;
+		budgetError(context, "execution interrupted");
+	}
+	else if (ecc->interruptRequest == Ecc(interruptTerminate))
+		budgetError(context, "execution terminated");
+	
+	if (ecc->maximumSteps)
+	{
+		if (ecc->stepCount >= ecc->maximumSteps)
+		{
+			ecc->interruptRequest = Ecc(interruptTerminate);
+			budgetError(context, "step budget exceeded");
+		}
+		
+		if (steps > ecc->maximumSteps - ecc->stepCount)
+			steps = ecc->maximumSteps - ecc->stepCount;
+		
+		ecc->stepCount += steps;
+	}
+	
+	if (ecc->timeLimit && Env.currentTime() >= ecc->timeLimit)
+	{
+		ecc->interruptRequest = Ecc(interruptTerminate);
+		budgetError(context, "time budget exceeded");
+	}
+	
+	ecc->stepCountdown = steps;
+}
+
 static inline
 struct Value callOps (struct Context * const context, struct Object *environment)
 {
+	struct Context *current = context->ecc->current;
+	struct Value result;
+	
 	if (context->depth >= context->ecc->maximumCallDepth)
 		Context.rangeError(context, Chars.create("maximum depth exceeded"));
 	
@@ -205,7 +326,17 @@ struct Value callOps (struct Context * const context, struct Object *environment
 //			context->this = Value.object(&context->ecc->global->environment);
 	
 	context->environment = environment;
-	return context->ops->native(context);
+	context->ecc->current = context;
+	stepBudget();
+	
+	#if PROFILE
+	result = Profile.op(context, context->ops);
+	#else
+	result = context->ops->native(context);
+	#endif
+	
+	context->ecc->current = current;
+	return result;
 }
 
 static inline
@@ -325,10 +456,124 @@ void populateEnvironmentWithOps (struct Context * const context, struct Object *
 	}
 }
 
+static inline
+void populateElementWithOps (struct Context * const context, union Object(Element) *element, int32_t elementCount, int32_t argumentCount)
+{
+	int32_t index = 0;
+	
+	for (; index < argumentCount && index < elementCount; ++index)
+		element[index].value = nextOpValue();
+	
+	for (; index < argumentCount; ++index)
+		nextOp();
+	
+	for (; index < elementCount; ++index)
+		element[index].value = Value(none);
+}
+
+static inline
+void populateElementWithVA (union Object(Element) *element, int32_t elementCount, int32_t argumentCount, va_list ap)
+{
+	int32_t index = 0;
+	
+	for (; index < argumentCount && index < elementCount; ++index)
+		element[index].value = va_arg(ap, struct Value);
+	
+	for (; index < elementCount; ++index)
+		element[index].value = Value(none);
+}
+
+static inline
+void populateElementWithArguments (union Object(Element) *element, int32_t elementCount, struct Object *arguments)
+{
+	int32_t index = 0, count = arguments->elementCount < elementCount? arguments->elementCount: elementCount;
+	
+	if (count)
+		memcpy(element, arguments->element, sizeof(*element) * count);
+	
+	for (index = count; index < elementCount; ++index)
+		element[index].value = Value(none);
+}
+
+void compileFunction (struct Context * const context, struct Function *function)
+{
+	struct Function *template = function;
+	struct Object *prototype = function->object.prototype;
+	
+	if (prototype && prototype != Function(prototype) && prototype->type == &Function(type) && ((struct Function *)prototype)->text.bytes == function->text.bytes)
+		template = (struct Function *)prototype;
+	
+	if (template->flags & Function(needCompile))
+	{
+		struct Ecc *ecc = context->ecc;
+		struct Input *input = Ecc.findInput(ecc, template->text);
+		struct Lexer *lexer = Lexer.createWithInput(input);
+		struct Parser *parser = Parser.createWithLexer(lexer);
+		struct Error *error;
+		
+		lexer->offset = (uint32_t)(template->text.bytes - input->bytes);
+		lexer->allowUnicodeOutsideLiteral = (template->flags & Function(sloppyMode)) != 0;
+		parser->lazyFunctions = 1;
+		
+		Parser.compileFunction(parser, template, &ecc->global->environment);
+		ecc->lazyFunctionCount += parser->lazyFunctionCount;
+		error = parser->error;
+		Parser.destroy(parser), parser = NULL;
+		
+		if (error)
+			Context.throw(context, Value.error(error));
+		
+		++ecc->lazyCompileCount;
+	}
+	
+	if (function != template && function->flags & Function(needCompile))
+	{
+		free(function->environment.hashmap);
+		function->environment.hashmap = template->environment.hashmap;
+		function->environment.hashmapCount = template->environment.hashmapCount;
+		function->environment.hashmapCapacity = template->environment.hashmapCapacity;
+		function->oplist = template->oplist;
+		function->flags = (function->flags | template->flags) & ~Function(needCompile);
+	}
+}
+
+static inline
+const struct Op * functionOps (struct Context * const context, struct Function * const function)
+{
+	if (function->flags & Function(needCompile))
+		compileFunction(context, function);
+	
+	return function->oplist->ops;
+}
+
+static inline
+int32_t nativeElementCount (struct Function * const function, int32_t argumentCount)
+{
+	return function->flags & Function(needArguments)? argumentCount: function->parameterCount;
+}
+
+static inline
+struct Value callNative (struct Context * const context, struct Function * const function, union Object(Element) *element, int32_t elementCount)
+{
+	struct Object environment = function->environment;
+	struct Object arguments = Object.identity;
+	union Object(Hashmap) hashmap[3];
+	
+	memcpy(hashmap, function->environment.hashmap, sizeof(hashmap));
+	environment.hashmap = hashmap;
+	environment.hashmapCount = environment.hashmapCapacity = 3;
+	
+	arguments.element = element;
+	arguments.elementCount = arguments.elementCapacity = elementCount;
+	replaceRefValue(&environment.hashmap[2].value, Value.object(&arguments));
+	
+	return callOps(context, &environment);
+}
+
 struct Value callFunctionArguments (struct Context * const context, enum Context(Offset) offset, struct Function *function, struct Value this, struct Object *arguments)
 {
 	struct Context subContext = {
-		.ops = function->oplist->ops,
+		.ops = functionOps(context, function),
 		.this = this,
 		.parent = context,
 		.ecc = context->ecc,
@@ -338,7 +583,16 @@ struct Value callFunctionArguments (struct Context * const context, enum Context
 		.refObject = function->refObject,
 	};
 	
-	if (function->flags & Function(needHeap))
+	if (function->flags & Function(isNative))
+	{
+		int32_t count = nativeElementCount(function, arguments->elementCount);
+		union Object(Element) element[count? count: 1];
+		
+		populateElementWithArguments(element, count, arguments);
+		
+		return callNative(&subContext, function, element, count);
+	}
+	else if (function->flags & Function(needHeap))
 	{
 		struct Object *environment = Object.copy(&function->environment);
 		
@@ -368,7 +622,7 @@ struct Value callFunctionArguments (struct Context * const context, enum Context
 struct Value callFunctionVA (struct Context * const context, enum Context(Offset) offset, struct Function *function, struct Value this, int argumentCount, va_list ap)
 {
 	struct Context subContext = {
-		.ops = function->oplist->ops,
+		.ops = functionOps(context, function),
 		.this = this,
 		.parent = context,
 		.ecc = context->ecc,
@@ -378,7 +632,16 @@ struct Value callFunctionVA (struct Context * const context, enum Context(Offset
 		.refObject = function->refObject,
 	};
 	
-	if (function->flags & Function(needHeap))
+	if (function->flags & Function(isNative))
+	{
+		int32_t count = nativeElementCount(function, argumentCount);
+		union Object(Element) element[count? count: 1];
+		
+		populateElementWithVA(element, count, argumentCount, ap);
+		
+		return callNative(&subContext, function, element, count);
+	}
+	else if (function->flags & Function(needHeap))
 	{
 		struct Object *environment = Object.copy(&function->environment);
 		
@@ -415,7 +678,7 @@ static inline
 struct Value callFunction (struct Context * const context, struct Function * const function, struct Value this, int32_t argumentCount, int construct)
 {
 	struct Context subContext = {
-		.ops = function->oplist->ops,
+		.ops = functionOps(context, function),
 		.this = this,
 		.parent = context,
 		.ecc = context->ecc,
@@ -425,7 +688,16 @@ struct Value callFunction (struct Context * const context, struct Function * con
 		.refObject = function->refObject,
 	};
 	
-	if (function->flags & Function(needHeap))
+	if (function->flags & Function(isNative))
+	{
+		int32_t count = nativeElementCount(function, argumentCount);
+		union Object(Element) element[count? count: 1];
+		
+		populateElementWithOps(context, element, count, argumentCount);
+		
+		return callNative(&subContext, function, element, count);
+	}
+	else if (function->flags & Function(needHeap))
 	{
 		struct Object *environment = Object.copy(&function->environment);
 		
@@ -472,17 +744,28 @@ struct Value callFunction (struct Context * const context, struct Function * con
 	}
 }
 
+Ecc(noreturn)
+static
+void callTypeError (struct Context * const context, const char *type)
+{
+	struct Text text;
+	
+	Context.setTextIndex(context, Context(funcIndex));
+	text = Context.textSeek(context);
+	Context.typeError(context, Chars.create("'%.*s' is not a %s", text.length, text.bytes, type));
+}
+
 static inline
 struct Value callValue (struct Context * const context, struct Value value, struct Value this, int32_t argumentCount, int construct, const struct Text *textCall)
 {
 	struct Value result;
 	const struct Text *parentTextCall = context->textCall;
 	
-	if (value.type != Value(functionType))
-		Context.typeError(context, Chars.create("'%.*s' is not a function", context->text->length, context->text->bytes));
-	
 	context->textCall = textCall;
 	
+	if (value.type != Value(functionType))
+		callTypeError(context, "function");
+	
 	if (value.data.function->flags & Function(useBoundThis))
 		result = callFunction(context, value.data.function, value.data.function->boundThis, argumentCount, construct);
 	else
@@ -495,7 +778,6 @@ struct Value callValue (struct Context * const context, struct Value value, stru
 struct Value construct (struct Context * const context)
 {
 	const struct Text *textCall = opText(0);
-	const struct Text *text = opText(1);
 	int32_t argumentCount = opValue().data.integer;
 	struct Value value, *prototype, object, function = nextOp();
 	
@@ -518,7 +800,6 @@ struct Value construct (struct Context * const context)
 	else
 		object = Value(undefined);
 	
-	Context.setText(context, text);
 	value = callValue(context, function, object, argumentCount, 1, textCall);
 	
 	if (Value.isObject(value))
@@ -528,14 +809,12 @@ struct Value construct (struct Context * const context)
 	
 error:
 	context->textCall = textCall;
-	Context.setTextIndex(context, Context(funcIndex));
-	Context.typeError(context, Chars.create("'%.*s' is not a constructor", text->length, text->bytes));
+	callTypeError(context, "constructor");
 }
 
 struct Value call (struct Context * const context)
 {
 	const struct Text *textCall = opText(0);
-	const struct Text *text = opText(1);
 	int32_t argumentCount = opValue().data.integer;
 	struct Value value;
 	struct Value this;
@@ -555,7 +834,6 @@ struct Value call (struct Context * const context)
 	else
 		this = Value(undefined);
 	
-	Context.setText(context, text);
 	return callValue(context, value, this, argumentCount, 0, textCall);
 }
 
@@ -878,6 +1156,9 @@ struct Value getMemberRef (struct Context * const context)
 	prepareObject(context, &object);
 	
 	context->refObject = object.data.object;
+	if (object.data.object->flags & Object(shared))
+		Ecc.unshareObject(object.data.object);
+	
 	ref = Object.member(object.data.object, key, Value(asOwn));
 	
 	if (!ref)
@@ -922,13 +1203,11 @@ struct Value callMember (struct Context * const context)
 {
 	const struct Text *textCall = opText(0);
 	int32_t argumentCount = opValue().data.integer;
-	const struct Text *text = &(++context->ops)->text;
-	struct Key key = opValue().data.key;
+	struct Key key = (++context->ops)->value.data.key;
 	struct Value object;
 	
 	prepareObject(context, &object);
 	
-	Context.setText(context, text);
 	return callValue(context, Object.getMember(context, object.data.object, key), object, argumentCount, 0, textCall);
 }
 
@@ -977,6 +1256,9 @@ struct Value getPropertyRef (struct Context * const context)
 	prepareObjectProperty(context, &object, &property);
 	
 	context->refObject = object.data.object;
+	if (object.data.object->flags & Object(shared))
+		Ecc.unshareObject(object.data.object);
+	
 	ref = Object.property(object.data.object, property, Value(asOwn));
 	
 	if (!ref)
@@ -1021,12 +1303,11 @@ struct Value callProperty (struct Context * const context)
 {
 	const struct Text *textCall = opText(0);
 	int32_t argumentCount = opValue().data.integer;
-	const struct Text *text = &(++context->ops)->text;
 	struct Value object, property;
 	
+	++context->ops;
 	prepareObjectProperty(context, &object, &property);
 	
-	Context.setText(context, text);
 	return callValue(context, Object.getProperty(context, object.data.object, property), object, argumentCount, 0, textCall);
 }
 
@@ -1323,7 +1604,7 @@ struct Value leftShift (struct Context * const context)
 {
 	struct Value a = nextOp();
 	struct Value b = nextOp();
-	return Value.binary(Value.toInteger(context, a).data.integer << (uint32_t)Value.toInteger(context, b).data.integer);
+	return Value.binary((int32_t)((uint32_t)Value.toInteger(context, a).data.integer << (uint32_t)Value.toInteger(context, b).data.integer));
 }
 
 struct Value rightShift (struct Context * const context)
@@ -1545,7 +1826,7 @@ struct Value moduloAssignRef (struct Context * const context)
 
 struct Value leftShiftAssignRef (struct Context * const context)
 {
-	assignIntegerOpRef(a.data.integer <<= (uint32_t)b.data.integer);
+	assignIntegerOpRef(a.data.integer = (int32_t)((uint32_t)a.data.integer << (uint32_t)b.data.integer));
 }
 
 struct Value rightShiftAssignRef (struct Context * const context)
@@ -1592,15 +1873,15 @@ struct Value try (struct Context * const context)
 	const struct Op *end = context->ops + opValue().data.integer;
 	struct Key key;
 	
-	const struct Op * volatile rethrowOps = NULL;
-	volatile int rethrow = 0, breaker = 0;
-	volatile struct Value value = Value(undefined);
-	struct Value finallyValue;
+	const struct Op *rethrowOps = NULL;
+	volatile int rethrow = 0;
+	int breaker;
+	struct Value value, finallyValue;
 	uint32_t indices[3];
 	
 	Pool.getIndices(indices);
 	
-	if (!setjmp(*Ecc.pushEnv(context->ecc))) // try
+	if (!Ecc(lightSetjmp)(*Ecc.pushLightEnv(context->ecc))) // try
 		value = nextOp();
 	else
 	{
@@ -1608,7 +1889,15 @@ struct Value try (struct Context * const context)
 		context->ecc->result = Value(undefined);
 		rethrowOps = context->ops;
 		
-		if (!rethrow) // catch
+		if (context->ecc->interruptRequest == Ecc(interruptTerminate)) // uncatchable
+		{
+			if (rethrow)
+				popEnvironment(context);
+			
+			Ecc.popEnv(context->ecc);
+			Context.throw(context, retain(value));
+		}
+		else if (!rethrow) // catch
 		{
 			Pool.unreferenceFromIndices(indices);
 			
@@ -1823,6 +2112,8 @@ struct Value repopulate (struct Context * const context)
 	int32_t offset = nextOp().data.integer;
 	const struct Op *nextOps = context->ops + offset;
 	
+	stepBudget();
+	
 	{
 		union Object(Hashmap) hashmap[context->environment->hashmapCapacity];
 		count = arguments <= context->environment->hashmapCapacity? arguments: context->environment->hashmapCapacity;
@@ -1869,6 +2160,20 @@ struct Value resultVoid (struct Context * const context)
 	return result;
 }
 
+static
+struct Value switchBody (struct Context * const context, const struct Op *nextOps)
+{
+	struct Value value = nextOp();
+	
+	if (context->breaker && --context->breaker)
+		return value;
+	else
+	{
+		context->ops = nextOps + 2 + nextOps[2].value.data.integer;
+		return nextOp();
+	}
+}
+
 struct Value switchOp (struct Context * const context)
 {
 	int32_t offset = opValue().data.integer;
@@ -1894,14 +2199,70 @@ struct Value switchOp (struct Context * const context)
 			++context->ops;
 	}
 	
-	value = nextOp();
-	if (context->breaker && --context->breaker)
-		return value;
-	else
+	return switchBody(context, nextOps);
+}
+
+static
+int32_t searchCase (const struct Op *cases, int32_t count, struct Value value)
+{
+	int32_t lower = 0, upper = count, middle;
+	
+	if (Value.isObject(value))
+		return -1;
+	else if (Value.isNumber(value))
 	{
-		context->ops = nextOps + 2 + nextOps[2].value.data.integer;
-		return nextOp();
+		double binary = caseBinary(value);
+		
+		if (binary != binary)
+			return -1;
+		
+		if (Value.isNumber(caseValue(&cases[0])))
+		{
+			double guess = binary - caseBinary(caseValue(&cases[0]));
+			
+			if (guess >= 0 && guess < count && guess == (int32_t)guess)
+			{
+				middle = guess;
+				if (!compareCase(caseValue(&cases[middle * 2]), value) && (!middle || compareCase(caseValue(&cases[middle * 2 - 2]), value)))
+					return middle;
+			}
+		}
 	}
+	else if (!Value.isString(value))
+		return -1;
+	
+	while (lower < upper)
+	{
+		middle = lower + (upper - lower) / 2;
+		
+		if (compareCase(caseValue(&cases[middle * 2]), value) < 0)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+	
+	if (lower < count && !compareCase(caseValue(&cases[lower * 2]), value))
+		return lower;
+	
+	return -1;
+}
+
+struct Value switchTable (struct Context * const context)
+{
+	int32_t offset = opValue().data.integer;
+	const struct Op *nextOps = context->ops + offset;
+	struct Value value;
+	int32_t index;
+	
+	value = trapOp(context, 1);
+	index = searchCase(context->ops + 1, (int32_t)(nextOps - context->ops) / 2, value);
+	
+	if (index >= 0)
+		context->ops = nextOps + context->ops[index * 2 + 2].value.data.integer;
+	else
+		context->ops = nextOps;
+	
+	return switchBody(context, nextOps);
 }
 
 // MARK: Iteration
@@ -1921,6 +2282,7 @@ struct Value switchOp (struct Context * const context)
 		else \
 		{ \
 			Pool.collectUnreferencedFromIndices(indices); \
+			stepBudget(); \
 			context->ops = nextOps; \
 		} \
 	}
@@ -2050,7 +2412,7 @@ struct Value iterateInRef (struct Context * const context)
 					continue;
 				
 				Chars.beginAppend(&chars);
-				Chars.append(&chars, "%d", index);
+				Chars.appendInt32(&chars, index);
 				key = Chars.endAppend(&chars);
 				replaceRefValue(ref, key);
 				
@@ -130,6 +130,7 @@
 		_( result )\
 		_( resultVoid )\
 		_( switchOp )\
+		_( switchTable )\
 		_( breaker )\
 		_( iterate )\
 		_( iterateLessRef )\
@@ -146,9 +147,11 @@ Interface(Op,
 	
 	(struct Op, make ,(const Native(Function) native, struct Value value, struct Text text))
 	(const char *, toChars ,(const Native(Function) native))
+	(void, sortCases ,(struct Op *cases, int32_t count))
 	
 	(struct Value, callFunctionArguments ,(struct Context * const, enum Context(Offset), struct Function *function, struct Value this, struct Object *arguments))
 	(struct Value, callFunctionVA ,(struct Context * const, enum Context(Offset), struct Function *function, struct Value this, int argumentCount, va_list ap))
+	(void, compileFunction ,(struct Context * const, struct Function *function))
 	
 	io_libecc_op_List
 	,
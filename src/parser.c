@@ -125,6 +125,15 @@ void popDepth (struct Parser *self)
 	--self->depthCount;
 }
 
+static
+void declareGlobal (struct Parser *self, struct Key key, enum Value(Flags) flags)
+{
+	struct Value *ref = Object.addMember(self->global, key, Value(undefined), flags);
+	
+	self->globals = realloc(self->globals, (self->globalCount + 1) * sizeof(*self->globals));
+	self->globals[self->globalCount++] = *ref;
+}
+
 
 // MARK: Expression
 
@@ -1131,7 +1140,7 @@ struct OpList * variableDeclaration (struct Parser *self, int noIn)
 	if (self->function->flags & Function(strictMode) || self->sourceDepth > 1)
 		Object.addMember(&self->function->environment, value.data.key, Value(undefined), Value(sealed));
 	else
-		Object.addMember(self->global, value.data.key, Value(undefined), Value(sealed));
+		declareGlobal(self, value.data.key, Value(sealed));
 	
 	if (acceptToken(self, '='))
 	{
@@ -1377,15 +1386,38 @@ struct OpList * returnStatement (struct Parser *self, struct Text text)
 	return oplist;
 }
 
+static
+int isConstantCase (struct OpList *oplist)
+{
+	if (!oplist || oplist->count != 1)
+		return 0;
+	else if (oplist->ops[0].native == Op.text)
+		return 1;
+	else if (oplist->ops[0].native == Op.value)
+	{
+		struct Value value = oplist->ops[0].value;
+		
+		if (Value.isString(value))
+			return 1;
+		else if (value.type == Value(integerType))
+			return 1;
+		else if (value.type == Value(binaryType))
+			return value.data.binary == value.data.binary;
+	}
+	return 0;
+}
+
 static
 struct OpList * switchStatement (struct Parser *self)
 {
-	struct OpList *oplist = NULL, *conditionOps = NULL, *defaultOps = NULL;
+	struct OpList *oplist = NULL, *conditionOps = NULL, *defaultOps = NULL, *caseOps;
 	struct Text text = Text(empty);
-	uint32_t conditionCount = 0;
+	uint32_t conditionCount = 0, caseIndex;
+	int constantCases = 1;
 	
 	expectToken(self, '(');
 	conditionOps = expression(self, 0);
+	caseIndex = conditionOps? conditionOps->count: 0;
 	expectToken(self, ')');
 	expectToken(self, '{');
 	pushDepth(self, Key(none), 1);
@@ -1396,7 +1428,9 @@ struct OpList * switchStatement (struct Parser *self)
 		
 		if (acceptToken(self, Lexer(caseToken)))
 		{
-			conditionOps = OpList.join(conditionOps, expression(self, 0));
+			caseOps = expression(self, 0);
+			constantCases = constantCases && isConstantCase(caseOps);
+			conditionOps = OpList.join(conditionOps, caseOps);
 			conditionOps = OpList.append(conditionOps, Op.make(Op.value, Value.integer(2 + (oplist? oplist->count: 0)), Text(empty)));
 			++conditionCount;
 			expectToken(self, ':');
@@ -1422,7 +1456,13 @@ struct OpList * switchStatement (struct Parser *self)
 	
 	oplist = OpList.appendNoop(oplist);
 	defaultOps = OpList.append(defaultOps, Op.make(Op.jump, Value.integer(oplist? oplist->count : 0), Text(empty)));
-	conditionOps = OpList.unshiftJoin(Op.make(Op.switchOp, Value.integer(conditionOps? conditionOps->count: 0), Text(empty)), conditionOps, defaultOps);
+	if (constantCases && conditionCount > 1 && conditionOps && caseIndex + conditionCount * 2 == conditionOps->count)
+	{
+		Op.sortCases(conditionOps->ops + caseIndex, conditionCount);
+		conditionOps = OpList.unshiftJoin(Op.make(Op.switchTable, Value.integer(conditionOps->count), Text(empty)), conditionOps, defaultOps);
+	}
+	else
+		conditionOps = OpList.unshiftJoin(Op.make(Op.switchOp, Value.integer(conditionOps? conditionOps->count: 0), Text(empty)), conditionOps, defaultOps);
 	oplist = OpList.join(conditionOps, oplist);
 	
 	popDepth(self);
@@ -1592,6 +1632,108 @@ struct OpList * parameters (struct Parser *self, int *count)
 	return NULL;
 }
 
+static
+int endsOperand (enum Lexer(Token) token)
+{
+	return token == Lexer(identifierToken)
+		|| token == Lexer(integerToken)
+		|| token == Lexer(binaryToken)
+		|| token == Lexer(stringToken)
+		|| token == Lexer(escapedStringToken)
+		|| token == Lexer(regexpToken)
+		|| token == Lexer(nullToken)
+		|| token == Lexer(trueToken)
+		|| token == Lexer(falseToken)
+		|| token == Lexer(thisToken)
+		|| token == Lexer(incrementToken)
+		|| token == Lexer(decrementToken)
+		|| token == ')'
+		|| token == ']'
+		;
+}
+
+static
+void prescanBody (struct Parser *self)
+{
+	struct Function *function = self->function;
+	enum Lexer(Token) token, previous = '{', beforePrevious = 0;
+	enum Lexer(Token) *brackets = NULL;
+	struct Key *assigned = NULL, key = Key(none);
+	uint32_t depth = 0, assignedCount = 0, index;
+	
+	if (previewToken(self) == Lexer(stringToken)
+		&& self->lexer->text.length == 10
+		&& !memcmp("use strict", self->lexer->text.bytes, 10)
+		)
+		function->flags |= Function(strictMode);
+	
+	while (( token = previewToken(self) ) && token != Lexer(errorToken))
+	{
+		if ((token == '/' || token == Lexer(divideAssignToken)) && !endsOperand(previous))
+		{
+			self->lexer->allowRegex = 1;
+			self->lexer->offset -= self->lexer->text.length;
+			token = nextToken(self);
+			self->lexer->allowRegex = 0;
+			
+			if (token != Lexer(regexpToken))
+			{
+				tokenError(self, "RegExp");
+				break;
+			}
+		}
+		else if (token == '(' || token == '[' || token == '{')
+		{
+			brackets = realloc(brackets, sizeof(*brackets) * (depth + 1));
+			brackets[depth++] = token == '('? ')': token == '['? ']': '}';
+		}
+		else if (token == ')' || token == ']' || token == '}')
+		{
+			if (!depth && token == '}')
+				break;
+			else if (!depth || brackets[depth - 1] != token)
+			{
+				char b[4];
+				tokenError(self, depth? Lexer.tokenChars(brackets[depth - 1], b): "'}'");
+				break;
+			}
+			--depth;
+		}
+		else if (token == Lexer(identifierToken))
+		{
+			key = self->lexer->value.data.key;
+			
+			if (Key.isEqual(key, Key(arguments)))
+				function->flags |= Function(needArguments) | Function(needHeap);
+		}
+		else if (token == Lexer(functionToken))
+			function->flags |= Function(needHeap);
+		else if (previous == Lexer(identifierToken) && (token == '=' || (token == Lexer(inToken) && beforePrevious == '(')))
+		{
+			if (!self->strictMode && !(function->flags & Function(strictMode)) && !Object.member(&function->environment, key, 0))
+			{
+				for (index = 0; index < assignedCount; ++index)
+					if (Key.isEqual(assigned[index], key))
+						break;
+				
+				if (index == assignedCount)
+				{
+					assigned = realloc(assigned, sizeof(*assigned) * (assignedCount + 1));
+					assigned[assignedCount++] = key;
+					++self->reserveGlobalSlots;
+				}
+			}
+		}
+		
+		beforePrevious = previous;
+		previous = token;
+		nextToken(self);
+	}
+	
+	free(brackets), brackets = NULL;
+	free(assigned), assigned = NULL;
+}
+
 static
 struct OpList * function (struct Parser *self, int isDeclaration, int isGetter, int isSetter)
 {
@@ -1656,7 +1798,17 @@ struct OpList * function (struct Parser *self, int isDeclaration, int isGetter,
 	if (parentFunction->flags & Function(strictMode))
 		self->function->flags |= Function(strictMode);
 	
-	oplist = OpList.join(oplist, sourceElements(self));
+	if (self->lazyFunctions)
+	{
+		prescanBody(self);
+		function->flags |= Function(needCompile);
+		if (self->lexer->allowUnicodeOutsideLiteral)
+			function->flags |= Function(sloppyMode);
+		++self->lazyFunctionCount;
+	}
+	else
+		oplist = OpList.join(oplist, sourceElements(self));
+	
 	text.length = (int32_t)(self->lexer->text.bytes - text.bytes) + 1;
 	expectToken(self, '}');
 	self->function = parentFunction;
@@ -1674,7 +1826,7 @@ struct OpList * function (struct Parser *self, int isDeclaration, int isGetter,
 		if (self->function->flags & Function(strictMode) || self->sourceDepth > 1)
 			Object.addMember(&parentFunction->environment, identifierOp.value.data.key, Value(undefined), Value(hidden));
 		else
-			Object.addMember(self->global, identifierOp.value.data.key, Value(undefined), Value(hidden));
+			declareGlobal(self, identifierOp.value.data.key, Value(hidden));
 	}
 	else if (identifierOp.value.type != Value(undefinedType) && !isGetter && !isSetter)
 	{
@@ -1753,6 +1905,7 @@ void destroy (struct Parser *self)
 	
 	Lexer.destroy(self->lexer), self->lexer = NULL;
 	free(self->depths), self->depths = NULL;
+	free(self->globals), self->globals = NULL;
 	free(self), self = NULL;
 }
 
@@ -1794,3 +1947,37 @@ struct Function * parseWithEnvironment (struct Parser * const self, struct Objec
 	function->oplist = oplist;
 	return function;
 }
+
+void compileFunction (struct Parser * const self, struct Function *function, struct Object *global)
+{
+	struct OpList *oplist;
+	
+	assert(self);
+	assert(function->flags & Function(needCompile));
+	
+	self->function = function;
+	self->global = global;
+	self->sourceDepth = 1;
+	self->strictMode = function->flags & Function(strictMode);
+	
+	nextToken(self);
+	expectToken(self, '(');
+	while (previewToken(self) == Lexer(identifierToken) || previewToken(self) == ',')
+		nextToken(self);
+	
+	expectToken(self, ')');
+	expectToken(self, '{');
+	oplist = sourceElements(self);
+	expectToken(self, '}');
+	
+	if (self->error)
+	{
+		OpList.destroy(oplist), oplist = NULL;
+		return;
+	}
+	
+	OpList.optimizeWithEnvironment(oplist, &function->environment, 0);
+	
+	function->oplist = oplist;
+	function->flags &= ~Function(needCompile);
+}
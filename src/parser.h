@@ -26,6 +26,7 @@ Interface(Parser,
 	(void, destroy, (struct Parser *))
 	
 	(struct Function *, parseWithEnvironment ,(struct Parser * const, struct Object *environment, struct Object *global))
+	(void, compileFunction ,(struct Parser * const, struct Function *, struct Object *global))
 	,
 	{
 		struct Lexer *lexer;
@@ -39,12 +40,16 @@ Interface(Parser,
 		uint16_t depthCount;
 		
 		struct Object *global;
+		struct Value *globals;
+		uint32_t globalCount;
 		struct Function *function;
 		uint16_t sourceDepth;
 		
 		int preferInteger;
 		int strictMode;
 		int reserveGlobalSlots;
+		int lazyFunctions;
+		uint32_t lazyFunctionCount;
 	}
 )
 
@@ -14,7 +14,14 @@
 static void markValue (struct Value value);
 static void cleanupObject(struct Object *object);
 
-static struct Pool *self = NULL;
+static Ecc(threadLocal) struct Pool *self = NULL;
+
+struct Extent {
+	uintptr_t begin;
+	uintptr_t end;
+	void *target;
+	int isChars;
+};
 
 // MARK: - Static Members
 
@@ -45,10 +52,76 @@ void markObject (struct Object *object)
 static
 void markChars (struct Chars *chars)
 {
-	if (chars->flags & Chars(mark))
-		return;
+	struct Chars(Rope) *rope;
+	struct Chars *shorter;
 	
-	chars->flags |= Chars(mark);
+	// ropes recurse into their shorter side only, keeping the depth logarithmic
+	while (!(chars->flags & Chars(mark)))
+	{
+		chars->flags |= Chars(mark);
+		
+		if (chars->flags & Chars(view))
+		{
+			chars = ((struct Chars(View) *)(chars + 1))->parent;
+			continue;
+		}
+		else if (!(chars->flags & Chars(rope)))
+			return;
+		
+		rope = (struct Chars(Rope) *)(chars + 1);
+		if (!rope->right)
+		{
+			chars = rope->left;
+			continue;
+		}
+		
+		if (rope->left->length < rope->right->length)
+			shorter = rope->left, chars = rope->right;
+		else
+			shorter = rope->right, chars = rope->left;
+		
+		markChars(shorter);
+	}
+}
+
+static
+void addExtent (struct Extent *extent, void *target, int isChars)
+{
+	struct Chars *chars = target;
+	
+	extent->begin = (uintptr_t)target;
+	extent->target = target;
+	extent->isChars = isChars;
+	
+	// chars are also reached through their bytes
+	if (!isChars)
+		extent->end = extent->begin + sizeof(struct Object);
+	else if (chars->flags & (Chars(rope) | Chars(view)))
+		extent->end = (uintptr_t)(chars + 1);
+	else
+		extent->end = (uintptr_t)(chars->bytes + chars->length + 1);
+}
+
+static
+int compareExtents (const void *a, const void *b)
+{
+	const struct Extent *ea = a, *eb = b;
+	
+	return ea->begin < eb->begin? -1: ea->begin > eb->begin? 1: 0;
+}
+
+static
+void applyFence (uint32_t indices[3])
+{
+	// what was created before the last task switch may still be in use on the other stack
+	if (indices[0] < self->fenceIndices[0])
+		indices[0] = self->fenceIndices[0];
+	
+	if (indices[1] < self->fenceIndices[1])
+		indices[1] = self->fenceIndices[1];
+	
+	if (indices[2] < self->fenceIndices[2])
+		indices[2] = self->fenceIndices[2];
 }
 
 // MARK: - Methods
@@ -274,6 +347,8 @@ void collectUnreferencedFromIndices (uint32_t indices[3])
 {
 	uint32_t index;
 	
+	applyFence(indices);
+	
 	// prepare
 	
 	index = self->objectCount;
@@ -312,6 +387,7 @@ void collectUnreferencedFromIndices (uint32_t indices[3])
 	while (index-- > indices[2])
 		if (self->charsList[index]->referenceCount <= 0)
 		{
+			Chars.release(self->charsList[index]);
 			Chars.destroy(self->charsList[index]);
 			self->charsList[index] = self->charsList[--self->charsCount];
 		}
@@ -321,6 +397,8 @@ void unreferenceFromIndices (uint32_t indices[3])
 {
 	uint32_t index;
 	
+	applyFence(indices);
+	
 	index = self->functionCount;
 	while (index-- > indices[0])
 	{
@@ -343,3 +421,66 @@ void getIndices (uint32_t indices[3])
 	indices[1] = self->objectCount;
 	indices[2] = self->charsCount;
 }
+
+void fence (void)
+{
+	getIndices(self->fenceIndices);
+}
+
+void clearFence (void)
+{
+	memset(self->fenceIndices, 0, sizeof(self->fenceIndices));
+}
+
+Ecc(noSanitize)
+void markRange (const void *begin, const void *end)
+{
+	struct Extent *extents;
+	uint32_t index, count = 0, lower, upper, middle;
+	const uintptr_t *word;
+	uintptr_t address;
+	
+	extents = malloc(sizeof(*extents) * (self->functionCount * 2 + self->objectCount + self->charsCount));
+	
+	for (index = 0; index < self->functionCount; ++index)
+	{
+		addExtent(extents + count++, &self->functionList[index]->object, 0);
+		addExtent(extents + count++, &self->functionList[index]->environment, 0);
+	}
+	
+	for (index = 0; index < self->objectCount; ++index)
+		addExtent(extents + count++, self->objectList[index], 0);
+	
+	for (index = 0; index < self->charsCount; ++index)
+		addExtent(extents + count++, self->charsList[index], 1);
+	
+	qsort(extents, count, sizeof(*extents), compareExtents);
+	
+	// any aligned word may be a pointer
+	word = (const uintptr_t *)(((uintptr_t)begin + sizeof(*word) - 1) & ~(uintptr_t)(sizeof(*word) - 1));
+	for (; (const char *)(word + 1) <= (const char *)end; ++word)
+	{
+		address = *word;
+		lower = 0;
+		upper = count;
+		
+		while (lower < upper)
+		{
+			middle = (lower + upper) / 2;
+			if (extents[middle].begin <= address)
+				lower = middle + 1;
+			else
+				upper = middle;
+		}
+		
+		if (lower && address < extents[lower - 1].end)
+		{
+			if (extents[lower - 1].isChars)
+				markChars(extents[lower - 1].target);
+			else
+				markObject(extents[lower - 1].target);
+		}
+	}
+	
+	free(extents), extents = NULL;
+}
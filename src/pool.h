@@ -38,6 +38,10 @@ Interface(Pool,
 	(void, unreferenceFromIndices ,(uint32_t indices[3]))
 	
 	(void, getIndices ,(uint32_t indices[3]))
+	
+	(void, fence ,(void))
+	(void, clearFence ,(void))
+	(void, markRange ,(const void *begin, const void *end))
 	,
 	{
 		struct Function **functionList;
@@ -51,6 +55,8 @@ Interface(Pool,
 		struct Chars **charsList;
 		uint32_t charsCount;
 		uint32_t charsCapacity;
+		
+		uint32_t fenceIndices[3];
 	}
 )
 
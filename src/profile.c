@@ -0,0 +1,735 @@
+//
+//  profile.c
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#if __linux__ && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE
+#endif
+
+#define Implementation
+#include "profile.h"
+
+#include "ecc.h"
+
+#if (__unix__ && !__MSDOS__) || (defined(__APPLE__) && defined(__MACH__))
+	#include <pthread.h>
+	#include <sys/time.h>
+	#define canSample 1
+#else
+	#define canSample 0
+#endif
+
+#if canSample && __linux__ && defined(SIGEV_THREAD_ID)
+	#include <time.h>
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#define canTargetThread 1
+	#ifndef sigev_notify_thread_id
+		#define sigev_notify_thread_id _sigev_un._tid
+	#endif
+#else
+	#define canTargetThread 0
+#endif
+
+#if __GNUC__
+	#define barrier() __asm__ __volatile__ ("" ::: "memory")
+#else
+	#define barrier()
+#endif
+
+// MARK: - Private
+
+enum {
+	sampleDepth = 32,
+	sampleCapacity = 1024,
+	sampleFrequency = 100,
+};
+
+struct Profile(Entry) {
+	const struct Op *op;
+	Native(Function) native;
+	struct Text text;
+	uint64_t count;
+	uint64_t ticks;
+};
+
+struct Profile(Timing) {
+	const struct Op *op;
+	const struct Text *text;
+	uint64_t start;
+	uint64_t childTicks;
+};
+
+struct Sample {
+	const char *name;
+	struct Input *input;
+	int32_t line;
+	uint64_t count;
+	uint64_t ticks;
+};
+
+struct Profile(Frame) {
+	const char *bytes;
+	int32_t length;
+	int32_t isCall;
+};
+
+struct Profile(Stack) {
+	struct Profile(Frame) frames[sampleDepth + 1];
+	uint32_t depth;
+	uint32_t hash;
+	uint64_t count;
+};
+
+static Ecc(threadLocal) struct Profile *self = NULL;
+
+// the signal handler is process-wide, so only one instance can be sampled at a time
+
+static struct {
+	char path[FILENAME_MAX];
+	struct Ecc *ecc;
+	
+	struct Profile(Stack) *ring;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t dropped;
+	
+	struct Profile(Stack) *stacks;
+	uint32_t stackCount;
+	uint32_t stackCapacity;
+	
+	#if canSample
+	struct sigaction action;
+	pthread_t thread;
+	#endif
+	#if canTargetThread
+	timer_t timer;
+	#endif
+} sampler;
+
+static
+uint64_t ticks (void)
+{
+#if __GNUC__ && (__i386__ || __x86_64__)
+	return __builtin_ia32_rdtsc();
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+#else
+	return clock();
+#endif
+}
+
+static
+uint32_t hashOp (const struct Op *op, uint32_t capacity)
+{
+	return (uint32_t)(((uintptr_t)op >> 3) * 2654435761u) & (capacity - 1);
+}
+
+static
+struct Profile(Entry) * findEntry (const struct Op *op, const struct Text *text)
+{
+	uint32_t index = hashOp(op, self->entryCapacity);
+	
+	while (self->entries[index].op)
+	{
+		struct Profile(Entry) *entry = self->entries + index;
+		
+		if (entry->op == op && entry->native == op->native)
+			return entry;
+		
+		index = (index + 1) & (self->entryCapacity - 1);
+	}
+	
+	if (self->entryCount * 2 >= self->entryCapacity)
+	{
+		struct Profile(Entry) *entries = self->entries;
+		uint32_t index, capacity = self->entryCapacity;
+		
+		self->entryCapacity *= 2;
+		self->entries = calloc(self->entryCapacity, sizeof(*self->entries));
+		
+		for (index = 0; index < capacity; ++index)
+			if (entries[index].op)
+			{
+				uint32_t slot = hashOp(entries[index].op, self->entryCapacity);
+				while (self->entries[slot].op)
+					slot = (slot + 1) & (self->entryCapacity - 1);
+				
+				self->entries[slot] = entries[index];
+			}
+		
+		free(entries), entries = NULL;
+		return findEntry(op, text);
+	}
+	
+	++self->entryCount;
+	self->entries[index].op = op;
+	self->entries[index].native = op->native;
+	self->entries[index].text = text? *text: Text(empty);
+	return self->entries + index;
+}
+
+static
+void closeTimings (uint32_t depth)
+{
+	struct Profile(Timing) *timing;
+	struct Profile(Entry) *entry;
+	uint64_t now = ticks(), elapsed;
+	
+	while (self->timingCount > depth)
+	{
+		timing = self->timings + --self->timingCount;
+		elapsed = now - timing->start;
+		entry = findEntry(timing->op, timing->text);
+		++entry->count;
+		entry->ticks += elapsed > timing->childTicks? elapsed - timing->childTicks: 0;
+		
+		if (self->timingCount)
+			timing[-1].childTicks += elapsed;
+	}
+}
+
+static
+int compareLocation (const void *a, const void *b)
+{
+	const struct Sample *sa = a, *sb = b;
+	
+	if (sa->input != sb->input)
+		return sa->input < sb->input? -1: 1;
+	else if (sa->line != sb->line)
+		return sa->line < sb->line? -1: 1;
+	else
+		return strcmp(sa->name, sb->name);
+}
+
+static
+int compareTicks (const void *a, const void *b)
+{
+	const struct Sample *sa = a, *sb = b;
+	
+	return sa->ticks < sb->ticks? 1: sa->ticks > sb->ticks? -1: 0;
+}
+
+static
+uint32_t merge (struct Sample *samples, uint32_t count, int byLine, int byName)
+{
+	uint32_t index, merged = 0;
+	
+	for (index = 0; index < count; ++index)
+	{
+		if (merged
+			&& (!byLine || (samples[merged - 1].input == samples[index].input && samples[merged - 1].line == samples[index].line))
+			&& (!byName || !strcmp(samples[merged - 1].name, samples[index].name))
+			)
+		{
+			samples[merged - 1].count += samples[index].count;
+			samples[merged - 1].ticks += samples[index].ticks;
+		}
+		else
+			samples[merged++] = samples[index];
+	}
+	return merged;
+}
+
+static
+const char * inputName (struct Input *input)
+{
+	return input? input->name: "(unknown)";
+}
+
+static
+void printSamples (FILE *file, const char *title, struct Sample *samples, uint32_t count, uint64_t total, int byLine, int byName)
+{
+	uint32_t index;
+	
+	fprintf(file, "-- %s --\n%14s %16s %7s  %s\n", title, "count", "ticks", "self", byName? "op": "line");
+	
+	for (index = 0; index < count; ++index)
+	{
+		fprintf(file, "%14llu %16llu %6.2f%%  ", (unsigned long long)samples[index].count, (unsigned long long)samples[index].ticks, total? samples[index].ticks * 100. / total: 0);
+		
+		if (byName)
+			fprintf(file, "%s", samples[index].name);
+		
+		if (byLine)
+			fprintf(file, "%s:%d", inputName(samples[index].input), samples[index].line);
+		
+		fputc('\n', file);
+	}
+	fputc('\n', file);
+}
+
+static
+uint32_t collectSamples (struct Ecc *ecc, struct Sample *samples)
+{
+	uint32_t index, count = 0;
+	
+	for (index = 0; index < self->entryCapacity; ++index)
+	{
+		struct Profile(Entry) *entry = self->entries + index;
+		struct Input *input;
+		
+		if (!entry->op)
+			continue;
+		
+		input = entry->text.length? Ecc.findInput(ecc, entry->text): NULL;
+		samples[count].name = entry->text.bytes == Text(nativeCode).bytes? "(native code)": Op.toChars(entry->native);
+		samples[count].input = input;
+		samples[count].line = input? Input.findLine(input, entry->text): 0;
+		samples[count].count = entry->count;
+		samples[count].ticks = entry->ticks;
+		++count;
+	}
+	return count;
+}
+
+static
+void writeCollapsed (FILE *file, struct Sample *samples, uint32_t count)
+{
+	uint32_t index;
+	
+	qsort(samples, count, sizeof(*samples), compareLocation);
+	count = merge(samples, count, 1, 1);
+	
+	for (index = 0; index < count; ++index)
+		fprintf(file, "%s:%d;%s %llu\n", inputName(samples[index].input), samples[index].line, samples[index].name, (unsigned long long)samples[index].ticks);
+}
+
+static
+void writeReport (FILE *file, const char *title, struct Sample *samples, uint32_t count, int byLine)
+{
+	uint64_t total = 0;
+	uint32_t index;
+	
+	for (index = 0; index < count; ++index)
+	{
+		total += samples[index].ticks;
+		
+		if (!byLine)
+			samples[index].input = NULL, samples[index].line = 0;
+	}
+	
+	qsort(samples, count, sizeof(*samples), compareLocation);
+	count = merge(samples, count, byLine, !byLine);
+	qsort(samples, count, sizeof(*samples), compareTicks);
+	printSamples(file, title, samples, count, total, byLine, !byLine);
+}
+
+static
+void sampleStack (int signal)
+{
+	struct Context *context = sampler.ecc->current;
+	struct Profile(Stack) *stack;
+	struct Profile(Frame) *frame;
+	const struct Op *op;
+	uint32_t head = sampler.head;
+	
+	#if canSample
+	if (!pthread_equal(pthread_self(), sampler.thread))
+		return;
+	#endif
+	
+	if (!context)
+		return;
+	
+	if (head - sampler.tail >= sampleCapacity)
+	{
+		++sampler.dropped;
+		return;
+	}
+	
+	stack = sampler.ring + head % sampleCapacity;
+	stack->depth = 0;
+	
+	for (; context && stack->depth <= sampleDepth; context = context->parent)
+	{
+		frame = stack->frames + stack->depth;
+		frame->isCall = 0;
+		
+		if (stack->depth++ && context->textCall)
+		{
+			frame->bytes = context->textCall->bytes;
+			frame->length = context->textCall->length;
+			frame->isCall = 1;
+		}
+		else if ((op = context->ops))
+		{
+			while (!op->text.length && !(op->text.flags & Text(breakFlag)))
+				--op;
+			
+			frame->bytes = op->text.bytes;
+			frame->length = op->text.length;
+		}
+		else
+			frame->bytes = NULL;
+	}
+	
+	barrier();
+	sampler.head = head + 1;
+	sampler.ecc->samplePending = 1;
+}
+
+static
+uint32_t hashStack (const struct Profile(Stack) *stack)
+{
+	uint32_t index, hash = 2166136261u;
+	
+	for (index = 0; index < stack->depth; ++index)
+		hash = (hash ^ (uint32_t)((uintptr_t)stack->frames[index].bytes >> 2 ^ stack->frames[index].length << 1 ^ stack->frames[index].isCall)) * 16777619u;
+	
+	return hash;
+}
+
+static
+int isSameStack (const struct Profile(Stack) *a, const struct Profile(Stack) *b)
+{
+	uint32_t index;
+	
+	if (a->hash != b->hash || a->depth != b->depth)
+		return 0;
+	
+	for (index = 0; index < a->depth; ++index)
+		if (a->frames[index].bytes != b->frames[index].bytes
+			|| a->frames[index].length != b->frames[index].length
+			|| a->frames[index].isCall != b->frames[index].isCall
+			)
+			return 0;
+	
+	return 1;
+}
+
+static
+void addStack (struct Profile(Stack) *stack)
+{
+	uint32_t index;
+	
+	if (sampler.stackCount * 2 >= sampler.stackCapacity)
+	{
+		struct Profile(Stack) *stacks = sampler.stacks;
+		uint32_t capacity = sampler.stackCapacity;
+		
+		sampler.stackCapacity = capacity? capacity * 2: 64;
+		sampler.stacks = calloc(sampler.stackCapacity, sizeof(*sampler.stacks));
+		
+		for (index = 0; index < capacity; ++index)
+			if (stacks[index].count)
+			{
+				uint32_t slot = stacks[index].hash & (sampler.stackCapacity - 1);
+				while (sampler.stacks[slot].count)
+					slot = (slot + 1) & (sampler.stackCapacity - 1);
+				
+				sampler.stacks[slot] = stacks[index];
+			}
+		
+		free(stacks), stacks = NULL;
+	}
+	
+	stack->hash = hashStack(stack);
+	index = stack->hash & (sampler.stackCapacity - 1);
+	
+	while (sampler.stacks[index].count)
+	{
+		if (isSameStack(sampler.stacks + index, stack))
+		{
+			++sampler.stacks[index].count;
+			return;
+		}
+		index = (index + 1) & (sampler.stackCapacity - 1);
+	}
+	
+	++sampler.stackCount;
+	sampler.stacks[index] = *stack;
+	sampler.stacks[index].count = 1;
+}
+
+static
+void printFrame (FILE *file, struct Ecc *ecc, const struct Profile(Frame) *frame, const struct Profile(Frame) *caller)
+{
+	struct Input *input;
+	int32_t length = 0;
+	
+	if (caller && caller->isCall)
+		while (length < caller->length && caller->bytes[length] != '(' && caller->bytes[length] != '\n')
+			++length;
+	
+	while (length && isspace(caller->bytes[length - 1]))
+		--length;
+	
+	if (length)
+		fprintf(file, "%.*s", length, caller->bytes);
+	else
+		fputs(caller? "(anonymous)": "(global)", file);
+	
+	if (frame->bytes == Text(nativeCode).bytes)
+		fputs(" (native code)", file);
+	else
+	{
+		input = Ecc.findInput(ecc, Text.make(frame->bytes, frame->length));
+		fprintf(file, " (%s:%d)", inputName(input), input? Input.findLine(input, Text.make(frame->bytes, frame->length)): 0);
+	}
+}
+
+static
+void writeStacks (FILE *file, struct Ecc *ecc)
+{
+	struct Profile(Stack) *stack;
+	uint32_t index, frame, separator;
+	
+	for (index = 0; index < sampler.stackCapacity; ++index)
+	{
+		stack = sampler.stacks + index;
+		if (!stack->count)
+			continue;
+		
+		separator = 0;
+		frame = stack->depth;
+		
+		if (frame > sampleDepth)
+		{
+			fputs("(truncated)", file);
+			separator = 1;
+			frame = sampleDepth;
+		}
+		
+		while (frame--)
+		{
+			if (!stack->frames[frame].bytes)
+				continue;
+			
+			if (separator++)
+				fputc(';', file);
+			
+			printFrame(file, ecc, stack->frames + frame, frame + 1 < stack->depth? stack->frames + frame + 1: NULL);
+		}
+		
+		fprintf(file, " %llu\n", (unsigned long long)stack->count);
+	}
+}
+
+static
+void stopSampling (struct Ecc *ecc)
+{
+	FILE *file;
+	
+	#if canTargetThread
+	timer_delete(sampler.timer);
+	sigaction(SIGPROF, &sampler.action, NULL);
+	#elif canSample
+	struct itimerval timer = { { 0 } };
+	
+	setitimer(ITIMER_PROF, &timer, NULL);
+	sigaction(SIGPROF, &sampler.action, NULL);
+	#endif
+	
+	drainSamples(ecc);
+	
+	if (sampler.dropped)
+		Env.printWarning("sampling profiler dropped %u samples", sampler.dropped);
+	
+	file = fopen(sampler.path, "w");
+	if (!file)
+		Env.printWarning("cannot open profile output '%s'", sampler.path);
+	else
+	{
+		writeStacks(file, ecc);
+		fclose(file), file = NULL;
+	}
+	
+	ecc->samplePending = 0;
+	free(sampler.ring), sampler.ring = NULL;
+	free(sampler.stacks), sampler.stacks = NULL;
+	memset(&sampler, 0, sizeof(sampler));
+}
+
+// MARK: - Static Members
+
+// MARK: - Methods
+
+void start (struct Ecc *ecc, const char *path, enum Profile(Format) format)
+{
+	assert(ecc);
+	assert(path);
+	
+	#if PROFILE
+	if (self)
+		return;
+	
+	self = malloc(sizeof(*self));
+	*self = Profile.identity;
+	
+	strncat(self->path, path, sizeof(self->path) - 1);
+	self->format = format;
+	self->ecc = ecc;
+	self->entryCapacity = 1024;
+	self->entries = calloc(self->entryCapacity, sizeof(*self->entries));
+	#else
+	Env.printWarning("profiler is not built in, rebuild with `make profile`");
+	#endif
+}
+
+void startSampling (struct Ecc *ecc, const char *path, int frequency)
+{
+	#if canTargetThread
+	struct sigaction action;
+	struct sigevent event;
+	struct itimerspec timer = { { 0 } };
+	#elif canSample
+	struct sigaction action;
+	struct itimerval timer = { { 0 } };
+	#endif
+	
+	assert(ecc);
+	assert(path);
+	
+	#if canSample
+	if (sampler.ecc)
+		return;
+	
+	if (frequency <= 0)
+		frequency = sampleFrequency;
+	
+	strncat(sampler.path, path, sizeof(sampler.path) - 1);
+	sampler.ring = malloc(sizeof(*sampler.ring) * sampleCapacity);
+	sampler.ecc = ecc;
+	sampler.thread = pthread_self();
+	
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = sampleStack;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGPROF, &action, &sampler.action);
+	
+	frequency = frequency < 1000000? 1000000 / frequency: 1;
+	
+	#if canTargetThread
+	// deliver SIGPROF to this thread only, on its own CPU time
+	memset(&event, 0, sizeof(event));
+	event.sigev_notify = SIGEV_THREAD_ID;
+	event.sigev_signo = SIGPROF;
+	event.sigev_notify_thread_id = syscall(SYS_gettid);
+	timer.it_interval.tv_sec = frequency / 1000000;
+	timer.it_interval.tv_nsec = frequency % 1000000 * 1000;
+	timer.it_value = timer.it_interval;
+	
+	if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &sampler.timer))
+	{
+		Env.printWarning("cannot create sampling timer");
+		sigaction(SIGPROF, &sampler.action, NULL);
+		free(sampler.ring), sampler.ring = NULL;
+		memset(&sampler, 0, sizeof(sampler));
+		return;
+	}
+	timer_settime(sampler.timer, 0, &timer, NULL);
+	#else
+	timer.it_interval.tv_sec = frequency / 1000000;
+	timer.it_interval.tv_usec = frequency % 1000000;
+	timer.it_value = timer.it_interval;
+	setitimer(ITIMER_PROF, &timer, NULL);
+	#endif
+	#else
+	Env.printWarning("sampling profiler is not supported on this platform");
+	#endif
+}
+
+void stop (struct Ecc *ecc)
+{
+	struct Sample *samples;
+	uint32_t count;
+	FILE *file;
+	
+	if (sampler.ecc == ecc)
+		stopSampling(ecc);
+	
+	if (!self || self->ecc != ecc)
+		return;
+	
+	file = fopen(self->path, "w");
+	if (!file)
+		Env.printWarning("cannot open profile output '%s'", self->path);
+	else
+	{
+		samples = malloc(sizeof(*samples) * (self->entryCount + 1));
+		
+		if (self->format == Profile(collapsed))
+			writeCollapsed(file, samples, collectSamples(ecc, samples));
+		else
+		{
+			count = collectSamples(ecc, samples);
+			writeReport(file, "lines", samples, count, 1);
+			count = collectSamples(ecc, samples);
+			writeReport(file, "ops", samples, count, 0);
+		}
+		
+		free(samples), samples = NULL;
+		fclose(file), file = NULL;
+	}
+	
+	free(self->entries), self->entries = NULL;
+	free(self->timings), self->timings = NULL;
+	free(self), self = NULL;
+}
+
+struct Value op (struct Context * const context, const struct Op *op)
+{
+	struct Profile(Timing) *timing;
+	struct Value value;
+	uint32_t depth;
+	
+	if (!self)
+		return op->native(context);
+	
+	if (self->timingCount >= self->timingCapacity)
+	{
+		self->timingCapacity = self->timingCapacity? self->timingCapacity * 2: 64;
+		self->timings = realloc(self->timings, sizeof(*self->timings) * self->timingCapacity);
+	}
+	
+	depth = self->timingCount++;
+	timing = self->timings + depth;
+	timing->op = op;
+	timing->text = op->text.length? &op->text: depth? timing[-1].text: NULL;
+	timing->childTicks = 0;
+	timing->start = ticks();
+	
+	value = op->native(context);
+	
+	closeTimings(depth);
+	return value;
+}
+
+uint32_t depth (void)
+{
+	return self? self->timingCount: 0;
+}
+
+void unwind (uint32_t depth)
+{
+	// ops a throw jumped over end there, so they are still counted
+	if (self && self->timingCount > depth)
+		closeTimings(depth);
+}
+
+void drainSamples (struct Ecc *ecc)
+{
+	uint32_t head, tail = sampler.tail;
+	
+	ecc->samplePending = 0;
+	
+	if (sampler.ecc != ecc)
+		return;
+	
+	head = sampler.head;
+	barrier();
+	
+	for (; tail != head; ++tail)
+		addStack(sampler.ring + tail % sampleCapacity);
+	
+	barrier();
+	sampler.tail = tail;
+}
@@ -0,0 +1,55 @@
+//
+//  profile.h
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#ifndef io_libecc_profile_h
+#ifdef Implementation
+#undef Implementation
+#include __FILE__
+#include "implementation.h"
+#else
+#include "interface.h"
+#define io_libecc_profile_h
+
+	#include "op.h"
+	
+	enum Profile(Format) {
+		Profile(report),
+		Profile(collapsed),
+	};
+
+#endif
+
+
+Interface(Profile,
+	
+	(void, start ,(struct Ecc *, const char *path, enum Profile(Format)))
+	(void, startSampling ,(struct Ecc *, const char *path, int frequency))
+	(void, stop ,(struct Ecc *))
+	
+	(void, drainSamples ,(struct Ecc *))
+	
+	(struct Value, op ,(struct Context * const, const struct Op *op))
+	(uint32_t, depth ,(void))
+	(void, unwind ,(uint32_t depth))
+	,
+	{
+		char path[FILENAME_MAX];
+		enum Profile(Format) format;
+		struct Ecc *ecc;
+		
+		struct Profile(Entry) *entries;
+		uint32_t entryCount;
+		uint32_t entryCapacity;
+		
+		struct Profile(Timing) *timings;
+		uint32_t timingCount;
+		uint32_t timingCapacity;
+	}
+)
+
+#endif
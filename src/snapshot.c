@@ -0,0 +1,468 @@
+//
+//  snapshot.c
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#define Implementation
+#include "snapshot.h"
+
+#include "pool.h"
+#include "builtin/string.h"
+
+// MARK: - Private
+
+enum {
+	copyTag = 1 << 0,
+	environmentTag = 1 << 1,
+	tagShift = 2,
+};
+
+struct Capture {
+	struct Snapshot *snapshot;
+	
+	struct Entry {
+		const void *address;
+		uintptr_t tag;
+	} *entries;
+	uint32_t entryCount;
+	uint32_t entryCapacity;
+	
+	struct Object **objects;
+	struct Object **stack;
+	uint32_t stackCount;
+	uint32_t stackCapacity;
+	
+	const struct Object(Type) *failedType;
+};
+
+// MARK: - Static Members
+
+static
+uint32_t sizeOfType (const struct Object(Type) *type)
+{
+	if (type == &Object(type) || type == &Array(type) || type == &Arguments(type) || type == &Global(type))
+		return sizeof(struct Object);
+	else if (type == &Function(type))
+		return sizeof(struct Function);
+	else if (type == &Error(type))
+		return sizeof(struct Error);
+	else if (type == &String(type))
+		return sizeof(struct String);
+	else if (type == &Number(type))
+		return sizeof(struct Number);
+	else if (type == &Boolean(type))
+		return sizeof(struct Boolean);
+	else if (type == &Date(type))
+		return sizeof(struct Date);
+	else if (type == &RegExp(type))
+		return sizeof(struct RegExp);
+	
+	return 0;
+}
+
+static
+uint32_t elementCount (const struct Object *object)
+{
+	return object->elementCount < object->elementCapacity? object->elementCount: object->elementCapacity;
+}
+
+static
+struct Entry * entry (struct Capture *self, const void *address)
+{
+	uint32_t mask = self->entryCapacity - 1;
+	uint32_t index = (uint32_t)(((uintptr_t)address >> 4) * 2654435761u) & mask;
+	
+	while (self->entries[index].address && self->entries[index].address != address)
+		index = (index + 1) & mask;
+	
+	return &self->entries[index];
+}
+
+static
+void insert (struct Capture *self, const void *address, uintptr_t tag)
+{
+	if (self->entryCount * 2 >= self->entryCapacity)
+	{
+		struct Entry *entries = self->entries;
+		uint32_t index, capacity = self->entryCapacity;
+		
+		self->entryCapacity = capacity? capacity * 2: 256;
+		self->entries = calloc(self->entryCapacity, sizeof(*self->entries));
+		
+		for (index = 0; index < capacity; ++index)
+			if (entries[index].address)
+				*entry(self, entries[index].address) = entries[index];
+		
+		free(entries), entries = NULL;
+	}
+	
+	*entry(self, address) = (struct Entry){ address, tag };
+	++self->entryCount;
+}
+
+static
+const struct Entry * lookup (struct Capture *self, const void *address)
+{
+	const struct Entry *found;
+	
+	if (!self->entryCount)
+		return NULL;
+	
+	found = entry(self, address);
+	return found->address? found: NULL;
+}
+
+static
+void push (struct Capture *self, struct Object *object)
+{
+	if (self->stackCount >= self->stackCapacity)
+	{
+		self->stackCapacity = self->stackCapacity? self->stackCapacity * 2: 64;
+		self->stack = realloc(self->stack, sizeof(*self->stack) * self->stackCapacity);
+	}
+	self->stack[self->stackCount++] = object;
+}
+
+static
+void share (struct Capture *self, struct Object *root)
+{
+	struct Object *object;
+	uint32_t index, count;
+	
+	push(self, root);
+	
+	while (self->stackCount)
+	{
+		object = self->stack[--self->stackCount];
+		
+		if (lookup(self, object))
+			continue;
+		
+		insert(self, object, 0);
+		
+		if (object->prototype)
+			push(self, object->prototype);
+		
+		for (index = 0, count = elementCount(object); index < count; ++index)
+			if (object->element[index].value.check == 1 && object->element[index].value.type >= Value(objectType))
+				push(self, object->element[index].value.data.object);
+		
+		for (index = 2, count = object->hashmapCount; index < count; ++index)
+			if (object->hashmap[index].value.check == 1 && object->hashmap[index].value.type >= Value(objectType))
+				push(self, object->hashmap[index].value.data.object);
+	}
+}
+
+static
+void visit (struct Capture *self, struct Object *object)
+{
+	struct Snapshot *snapshot = self->snapshot;
+	uintptr_t tag;
+	uint32_t size;
+	
+	if (!object || lookup(self, object))
+		return;
+	
+	if (!(size = sizeOfType(object->type)))
+	{
+		self->failedType = object->type;
+		insert(self, object, 0);
+		return;
+	}
+	
+	snapshot->nodes = realloc(snapshot->nodes, sizeof(*snapshot->nodes) * (snapshot->nodeCount + 1));
+	snapshot->nodes[snapshot->nodeCount] = (struct Snapshot(Node)){ object->type, 0, size };
+	
+	self->objects = realloc(self->objects, sizeof(*self->objects) * (snapshot->nodeCount + 1));
+	self->objects[snapshot->nodeCount] = object;
+	
+	tag = ((uintptr_t)snapshot->nodeCount++ << tagShift) | copyTag;
+	insert(self, object, tag);
+	
+	if (object->type == &Function(type))
+		insert(self, &((struct Function *)object)->environment, tag | environmentTag);
+}
+
+static
+void visitValue (struct Capture *self, struct Value value)
+{
+	if (value.check == 1 && value.type >= Value(objectType))
+		visit(self, value.data.object);
+}
+
+static
+void visitObject (struct Capture *self, struct Object *object)
+{
+	uint32_t index, count;
+	
+	visit(self, object->prototype);
+	
+	for (index = 0, count = elementCount(object); index < count; ++index)
+		visitValue(self, object->element[index].value);
+	
+	for (index = 2, count = object->hashmapCount; index < count; ++index)
+		visitValue(self, object->hashmap[index].value);
+}
+
+static
+void visitNode (struct Capture *self, struct Object *object)
+{
+	if (object->type == &Function(type))
+	{
+		struct Function *function = (struct Function *)object;
+		
+		// closures inherit from their template, owned by the ops of the snapshot instance
+		if (!(function->flags & Function(isNative)) && function->object.prototype != Function(prototype) && !lookup(self, function->object.prototype))
+			insert(self, function->object.prototype, 0);
+		
+		visitObject(self, &function->object);
+		visitObject(self, &function->environment);
+		visit(self, function->refObject);
+		visit(self, function->pair ? &function->pair->object: NULL);
+		visitValue(self, function->boundThis);
+	}
+	else
+		visitObject(self, object);
+}
+
+static
+void * encode (struct Capture *self, void *address)
+{
+	const struct Entry *found;
+	
+	if (address && (found = lookup(self, address)) && found->tag & copyTag)
+		return (void *)found->tag;
+	
+	return address;
+}
+
+static
+void encodeValue (struct Capture *self, struct Value *value)
+{
+	if (value->check == 1 && value->type >= Value(objectType))
+		value->data.object = encode(self, value->data.object);
+}
+
+static
+char * writeObject (struct Capture *self, char *bytes, struct Object *image, const struct Object *object)
+{
+	uint32_t index, count, size;
+	
+	image->prototype = encode(self, object->prototype);
+	
+	size = sizeof(*object->hashmap) * object->hashmapCapacity;
+	if (size)
+		memcpy(bytes, object->hashmap, size);
+	for (index = 2, count = object->hashmapCount; index < count; ++index)
+		encodeValue(self, &((union Object(Hashmap) *)bytes)[index].value);
+	
+	bytes += size;
+	
+	size = sizeof(*object->element) * object->elementCapacity;
+	if (size)
+		memcpy(bytes, object->element, size);
+	for (index = 0, count = elementCount(object); index < count; ++index)
+		encodeValue(self, &((union Object(Element) *)bytes)[index].value);
+	
+	return bytes + size;
+}
+
+static
+uint32_t objectSize (const struct Object *object)
+{
+	return sizeof(*object->hashmap) * object->hashmapCapacity + sizeof(*object->element) * object->elementCapacity;
+}
+
+static
+void * relocate (void **pointers, void *address)
+{
+	uintptr_t tag = (uintptr_t)address;
+	
+	if (!(tag & copyTag))
+		return address;
+	else if (tag & environmentTag)
+		return &((struct Function *)pointers[tag >> tagShift])->environment;
+	else
+		return pointers[tag >> tagShift];
+}
+
+static
+const char * restoreObject (struct Object *object, const char *bytes, void **pointers)
+{
+	struct Value *value;
+	uint32_t index, count, size;
+	
+	object->prototype = relocate(pointers, object->prototype);
+	
+	size = sizeof(*object->hashmap) * object->hashmapCapacity;
+	object->hashmap = size? memcpy(malloc(size), bytes, size): NULL;
+	bytes += size;
+	
+	size = sizeof(*object->element) * object->elementCapacity;
+	object->element = size? memcpy(malloc(size), bytes, size): NULL;
+	bytes += size;
+	
+	for (index = 2, count = object->hashmapCount; index < count; ++index)
+		if ((value = &object->hashmap[index].value)->check == 1 && value->type >= Value(objectType))
+			value->data.object = relocate(pointers, value->data.object);
+	
+	for (index = 0, count = elementCount(object); index < count; ++index)
+		if ((value = &object->element[index].value)->check == 1 && value->type >= Value(objectType))
+			value->data.object = relocate(pointers, value->data.object);
+	
+	return bytes;
+}
+
+// MARK: - Methods
+
+struct Snapshot * createFromEcc (struct Ecc *ecc)
+{
+	struct Function * const roots[] = {
+		Object(constructor), Function(constructor), Array(constructor), String(constructor),
+		Boolean(constructor), Number(constructor), Date(constructor), RegExp(constructor),
+		Error(constructor), Error(rangeConstructor), Error(referenceConstructor), Error(syntaxConstructor),
+		Error(typeConstructor), Error(uriConstructor), Error(evalConstructor),
+	};
+	struct Snapshot *self = malloc(sizeof(*self));
+	struct Capture capture = { self };
+	uint32_t index, count;
+	char *bytes;
+	
+	assert(ecc);
+	
+	*self = Snapshot.identity;
+	self->ecc = ecc;
+	
+	// builtins changed by the bootstrap become what every instance of the thread sees
+	Ecc.publishBuiltins(ecc);
+	
+	// the global function comes first so that builtins referring to it don't share it
+	visit(&capture, &ecc->global->object);
+	
+	share(&capture, Object(prototype));
+	share(&capture, Function(prototype));
+	share(&capture, Arguments(prototype));
+	share(&capture, Math(object));
+	share(&capture, JSON(object));
+	for (index = 0, count = sizeof(roots) / sizeof(*roots); index < count; ++index)
+		share(&capture, &roots[index]->object);
+	
+	for (index = 0; index < self->nodeCount; ++index)
+		visitNode(&capture, capture.objects[index]);
+	
+	if (capture.failedType)
+	{
+		const char type[] = "Snapshot";
+		Env.printError(sizeof(type)-1, type, "cannot copy %.*s object", capture.failedType->text->length, capture.failedType->text->bytes);
+		destroy(self), self = NULL;
+	}
+	else
+	{
+		for (index = 0; index < self->nodeCount; ++index)
+		{
+			struct Object *object = capture.objects[index];
+			
+			self->nodes[index].offset = self->byteCount;
+			self->byteCount += self->nodes[index].size + objectSize(object);
+			
+			if (object->type == &Function(type))
+				self->byteCount += objectSize(&((struct Function *)object)->environment);
+		}
+		
+		self->bytes = malloc(self->byteCount);
+		
+		for (index = 0; index < self->nodeCount; ++index)
+		{
+			struct Object *object = capture.objects[index];
+			struct Snapshot(Node) *node = &self->nodes[index];
+			struct Object *image = (struct Object *)(self->bytes + node->offset);
+			
+			bytes = memcpy(image, object, node->size);
+			bytes = writeObject(&capture, bytes + node->size, image, object);
+			
+			if (object->type == &Function(type))
+			{
+				struct Function *function = (struct Function *)object, *functionImage = (struct Function *)image;
+				
+				bytes = writeObject(&capture, bytes, &functionImage->environment, &function->environment);
+				functionImage->refObject = encode(&capture, function->refObject);
+				functionImage->pair = encode(&capture, function->pair);
+				encodeValue(&capture, &functionImage->boundThis);
+			}
+		}
+	}
+	
+	free(capture.entries), capture.entries = NULL;
+	free(capture.objects), capture.objects = NULL;
+	free(capture.stack), capture.stack = NULL;
+	
+	return self;
+}
+
+void destroy (struct Snapshot *self)
+{
+	assert(self);
+	
+	free(self->nodes), self->nodes = NULL;
+	free(self->bytes), self->bytes = NULL;
+	free(self), self = NULL;
+}
+
+struct Function * restoreGlobal (struct Snapshot *self)
+{
+	void **pointers;
+	struct Function *global;
+	const char *bytes;
+	uint32_t index;
+	
+	assert(self);
+	assert(self->nodeCount);
+	
+	pointers = malloc(sizeof(*pointers) * self->nodeCount);
+	
+	for (index = 0; index < self->nodeCount; ++index)
+		pointers[index] = memcpy(malloc(self->nodes[index].size), self->bytes + self->nodes[index].offset, self->nodes[index].size);
+	
+	for (index = 0; index < self->nodeCount; ++index)
+	{
+		const struct Snapshot(Node) *node = &self->nodes[index];
+		struct Object *object = pointers[index];
+		
+		bytes = restoreObject(object, self->bytes + node->offset + node->size, pointers);
+		
+		if (node->type == &Function(type))
+		{
+			struct Function *function = pointers[index];
+			
+			restoreObject(&function->environment, bytes, pointers);
+			function->refObject = relocate(pointers, function->refObject);
+			function->pair = relocate(pointers, function->pair);
+			
+			if (function->boundThis.check == 1 && function->boundThis.type >= Value(objectType))
+				function->boundThis.data.object = relocate(pointers, function->boundThis.data.object);
+			
+			// only the global function owns its (empty) oplist, others share the ones of the snapshot instance
+			if (index)
+				Pool.addObject(&function->object);
+			else
+				Pool.addFunction(function);
+		}
+		else
+		{
+			if (node->type == &RegExp(type))
+				RegExp.recompile((struct RegExp *)object);
+			else if (node->type == &String(type))
+				++((struct String *)object)->value->referenceCount;
+			
+			Pool.addObject(object);
+		}
+	}
+	
+	global = pointers[0];
+	free(pointers), pointers = NULL;
+	
+	return global;
+}
@@ -0,0 +1,47 @@
+//
+//  snapshot.h
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#ifndef io_libecc_snapshot_h
+#ifdef Implementation
+#undef Implementation
+#include __FILE__
+#include "implementation.h"
+#else
+#include "interface.h"
+#define io_libecc_snapshot_h
+
+	#include "ecc.h"
+	
+	struct Snapshot(Node) {
+		const struct Object(Type) *type;
+		uint32_t offset;
+		uint32_t size;
+	};
+
+#endif
+
+
+Interface(Snapshot,
+	
+	(struct Snapshot *, createFromEcc ,(struct Ecc *))
+	(void, destroy ,(struct Snapshot *))
+	
+	(struct Function *, restoreGlobal ,(struct Snapshot *))
+	,
+	{
+		struct Ecc *ecc;
+		
+		struct Snapshot(Node) *nodes;
+		uint32_t nodeCount;
+		
+		char *bytes;
+		uint32_t byteCount;
+	}
+)
+
+#endif
@@ -0,0 +1,376 @@
+//
+//  task.c
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#if defined(__APPLE__) && defined(__MACH__) && !defined(_XOPEN_SOURCE)
+	#define _XOPEN_SOURCE 600
+#endif
+
+#define Implementation
+#include "task.h"
+
+#include "pool.h"
+
+#if (__unix__ && !__MSDOS__) || (defined(__APPLE__) && defined(__MACH__))
+	#include <ucontext.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#define canSuspend 1
+#else
+	#define canSuspend 0
+#endif
+
+#ifndef MAP_ANONYMOUS
+	#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifndef MAP_NORESERVE
+	#define MAP_NORESERVE 0
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+	#define hasAddressSanitizer 1
+#elif defined(__has_feature)
+	#if __has_feature(address_sanitizer)
+		#define hasAddressSanitizer 1
+	#endif
+#endif
+
+#if hasAddressSanitizer
+	/* tell ASan which stack is in use, or it reports frames of the other one */
+	#include <sanitizer/common_interface_defs.h>
+	#define startSwitch(save, bottom, size) __sanitizer_start_switch_fiber(save, bottom, size)
+	#define finishSwitch(save, bottom, size) __sanitizer_finish_switch_fiber(save, bottom, size)
+#else
+	#define startSwitch(save, bottom, size)
+	#define finishSwitch(save, bottom, size)
+#endif
+
+// MARK: - Private
+
+enum {
+	defaultStackSize = 1024 * 1024,
+};
+
+struct Task(Fiber) {
+#if canSuspend
+	ucontext_t task;
+	ucontext_t host;
+#endif
+#if hasAddressSanitizer
+	void *taskFakeStack;
+	void *hostFakeStack;
+	const void *hostStack;
+	size_t hostSize;
+#endif
+	char *stack;
+	char *suspendedAt;
+	size_t size;
+};
+
+struct Task(Holder) {
+	struct Object object;
+	struct Task *task;
+};
+
+static Ecc(threadLocal) struct Task *currentTask = NULL;
+static Ecc(threadLocal) uint32_t liveCount = 0;
+
+// MARK: - Static Members
+
+#if canSuspend
+
+static
+void markHolder (struct Object *object)
+{
+	struct Task *self = ((struct Task(Holder) *)object)->task;
+	
+	// a suspended script is only referenced from its stack and the registers saved with it
+	if (self && self->state == Task(suspended))
+	{
+		Pool.markRange(&self->fiber->task, &self->fiber->task + 1);
+		Pool.markRange(self->envList, self->envList + self->envCount);
+		Pool.markRange(self->fiber->suspendedAt, self->fiber->stack + self->fiber->size);
+		Pool.markValue(self->resumeValue);
+	}
+}
+
+static const struct Object(Type) holderType = {
+	.text = &Text(objectType),
+	.mark = markHolder,
+};
+
+static
+void holdValue (struct Object *holder, uint32_t index, struct Value value)
+{
+	if (value.type == Value(charsType))
+		++value.data.chars->referenceCount;
+	else if (value.type >= Value(objectType))
+		++value.data.object->referenceCount;
+	
+	Object.addElement(holder, index, value, 0);
+}
+
+static
+void exchange (struct Task *self)
+{
+	struct Ecc *ecc = self->ecc;
+	struct Ecc(Env) *envList = ecc->envList;
+	uint16_t envCount = ecc->envCount;
+	uint16_t envCapacity = ecc->envCapacity;
+	struct Context *current = ecc->current;
+	unsigned printLastThrow = ecc->printLastThrow;
+	
+	ecc->envList = self->envList;
+	ecc->envCount = self->envCount;
+	ecc->envCapacity = self->envCapacity;
+	ecc->current = self->current;
+	ecc->printLastThrow = self->printLastThrow;
+	
+	self->envList = envList;
+	self->envCount = envCount;
+	self->envCapacity = envCapacity;
+	self->current = current;
+	self->printLastThrow = printLastThrow;
+}
+
+Ecc(useframe)
+static
+void start (void)
+{
+	struct Task *self = currentTask;
+	struct Ecc *ecc = self->ecc;
+	union Object(Element) *element = self->holder->element;
+	
+	finishSwitch(NULL, &self->fiber->hostStack, &self->fiber->hostSize);
+	
+	if (!setjmp(*Ecc.pushEnv(ecc)))
+	{
+		Ecc.callFunction(ecc, element[0].value.data.function, element[1].value, element[2].value.type == Value(objectType)? element[2].value.data.object: NULL);
+		self->state = Task(done);
+	}
+	else
+	{
+		self->state = Task(failed);
+		ecc->interruptRequest = 0;
+	}
+	
+	Ecc.popEnv(ecc);
+	
+	self->result = ecc->result;
+	ecc->result = Value(undefined);
+	
+	// keeps the result until the task is destroyed
+	holdValue(self->holder, 3, self->result);
+	
+	/* returns to the host through uc_link */
+	startSwitch(NULL, self->fiber->hostStack, self->fiber->hostSize);
+}
+
+static
+enum Task(State) enter (struct Task *self, struct Value value, int throwing)
+{
+	assert(self);
+	assert(self->state == Task(created) || self->state == Task(suspended));
+	
+	self->resumeValue = value;
+	self->throwing = throwing;
+	
+	// expressions the script left pending must not collect what the host created meanwhile
+	Pool.fence();
+	
+	exchange(self);
+	Ecc.activate(self->ecc);
+	
+	self->previous = currentTask;
+	self->state = Task(running);
+	currentTask = self;
+	
+	startSwitch(&self->fiber->hostFakeStack, self->fiber->stack, self->fiber->size);
+	swapcontext(&self->fiber->host, &self->fiber->task);
+	finishSwitch(self->fiber->hostFakeStack, NULL, NULL);
+	
+	currentTask = self->previous;
+	self->previous = NULL;
+	
+	exchange(self);
+	
+	return self->state;
+}
+
+static
+void releaseHolder (struct Object *holder)
+{
+	union Object(Element) *element;
+	uint32_t index;
+	
+	for (index = 0; index < holder->elementCount; ++index)
+	{
+		element = holder->element + index;
+		
+		if (element->value.type == Value(charsType))
+			--element->value.data.chars->referenceCount;
+		else if (element->value.type >= Value(objectType))
+			--element->value.data.object->referenceCount;
+	}
+	
+	// emptied so that collecting the holder does not release its elements again
+	holder->elementCount = 0;
+	--holder->referenceCount;
+}
+
+#endif
+
+// MARK: - Methods
+
+struct Task * create (struct Ecc *ecc, struct Function *function, struct Value this, struct Object *arguments, uint32_t stackSize)
+{
+	struct Task *self = NULL;
+	
+	#if canSuspend
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	struct Task(Fiber) *fiber;
+	struct Task(Holder) *holder;
+	
+	assert(ecc);
+	assert(function);
+	
+	fiber = calloc(1, sizeof(*fiber));
+	fiber->size = ((stackSize? stackSize: defaultStackSize) + page - 1) / page * page + page;
+	fiber->stack = mmap(NULL, fiber->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	
+	if (fiber->stack == MAP_FAILED || getcontext(&fiber->task))
+	{
+		if (fiber->stack != MAP_FAILED)
+			munmap(fiber->stack, fiber->size);
+		
+		free(fiber), fiber = NULL;
+		return NULL;
+	}
+	
+	// overflowing the stack faults on the guard page instead of corrupting memory
+	mprotect(fiber->stack, page, PROT_NONE);
+	
+	fiber->task.uc_stack.ss_sp = fiber->stack;
+	fiber->task.uc_stack.ss_size = fiber->size;
+	fiber->task.uc_link = &fiber->host;
+	makecontext(&fiber->task, start, 0);
+	
+	self = malloc(sizeof(*self));
+	*self = Task.identity;
+	self->ecc = ecc;
+	self->fiber = fiber;
+	
+	holder = malloc(sizeof(*holder));
+	Pool.addObject(&holder->object);
+	Object.initialize(&holder->object, NULL);
+	holder->object.type = &holderType;
+	holder->task = self;
+	
+	self->holder = &holder->object;
+	++self->holder->referenceCount;
+	Ecc.addRoot(ecc, self->holder);
+	
+	holdValue(self->holder, 0, Value.function(function));
+	holdValue(self->holder, 1, this);
+	holdValue(self->holder, 2, arguments? Value.object(arguments): Value(undefined));
+	
+	++liveCount;
+	#endif
+	
+	return self;
+}
+
+void destroy (struct Task *self)
+{
+	#if canSuspend
+	assert(self);
+	assert(self->state != Task(running));
+	
+	// unwinds the script with an uncatchable error so its native frames are left
+	if (self->state == Task(suspended))
+	{
+		self->cancel = 1;
+		enter(self, Value(undefined), 0);
+	}
+	
+	Ecc.removeRoot(self->ecc, self->holder);
+	releaseHolder(self->holder);
+	((struct Task(Holder) *)self->holder)->task = NULL;
+	
+	munmap(self->fiber->stack, self->fiber->size);
+	free(self->fiber), self->fiber = NULL;
+	free(self->envList), self->envList = NULL;
+	free(self), self = NULL;
+	
+	// with no task left, every pending expression belongs to the host again
+	if (!--liveCount)
+		Pool.clearFence();
+	#endif
+}
+
+enum Task(State) resume (struct Task *self, struct Value value)
+{
+	#if canSuspend
+	return enter(self, value, 0);
+	#else
+	return Task(failed);
+	#endif
+}
+
+enum Task(State) resumeThrowing (struct Task *self, struct Value error)
+{
+	#if canSuspend
+	return enter(self, error, 1);
+	#else
+	return Task(failed);
+	#endif
+}
+
+struct Value suspend (struct Context * const context)
+{
+	#if canSuspend
+	struct Task *self = currentTask;
+	char here;
+	
+	if (!self || self->ecc != context->ecc)
+		Context.typeError(context, Chars.create("cannot suspend outside of a task"));
+	
+	// the host's pending expressions must not collect what this run created,
+	// and a full collection marks it from the stack above here
+	Pool.fence();
+	self->fiber->suspendedAt = &here;
+	
+	self->state = Task(suspended);
+	startSwitch(&self->fiber->taskFakeStack, self->fiber->hostStack, self->fiber->hostSize);
+	swapcontext(&self->fiber->task, &self->fiber->host);
+	finishSwitch(self->fiber->taskFakeStack, &self->fiber->hostStack, &self->fiber->hostSize);
+	
+	if (self->cancel)
+	{
+		context->ecc->interruptRequest = Ecc(interruptTerminate);
+		Context.rangeError(context, Chars.create("task cancelled"));
+	}
+	
+	if (self->throwing)
+		Context.throw(context, self->resumeValue);
+	
+	return self->resumeValue;
+	#else
+	Context.typeError(context, Chars.create("cannot suspend outside of a task"));
+	#endif
+}
+
+struct Task * current (struct Ecc *ecc)
+{
+	#if canSuspend
+	if (currentTask && currentTask->ecc == ecc)
+		return currentTask;
+	#endif
+	
+	return NULL;
+}
@@ -0,0 +1,63 @@
+//
+//  task.h
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#ifndef io_libecc_task_h
+#ifdef Implementation
+#undef Implementation
+#include __FILE__
+#include "implementation.h"
+#else
+#include "interface.h"
+#define io_libecc_task_h
+
+	#include "ecc.h"
+	
+	enum Task(State) {
+		Task(created),
+		Task(running),
+		Task(suspended),
+		Task(done),
+		Task(failed),
+	};
+
+#endif
+
+
+Interface(Task,
+	
+	(struct Task *, create ,(struct Ecc *, struct Function *, struct Value this, struct Object *arguments, uint32_t stackSize))
+	(void, destroy ,(struct Task *))
+	
+	(enum Task(State), resume ,(struct Task *, struct Value value))
+	(enum Task(State), resumeThrowing ,(struct Task *, struct Value error))
+	(struct Value, suspend ,(struct Context * const))
+	(struct Task *, current ,(struct Ecc *))
+	,
+	{
+		struct Ecc *ecc;
+		struct Task(Fiber) *fiber;
+		struct Object *holder;
+		struct Task *previous;
+		void *data;
+		
+		enum Task(State) state;
+		struct Value result;
+		struct Value resumeValue;
+		
+		struct Ecc(Env) *envList;
+		uint16_t envCount;
+		uint16_t envCapacity;
+		struct Context *current;
+		
+		unsigned printLastThrow:1;
+		unsigned throwing:1;
+		unsigned cancel:1;
+	}
+)
+
+#endif
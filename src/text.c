@@ -9,6 +9,14 @@
 #define Implementation
 #include "text.h"
 
+#if __GNUC__ && __x86_64__
+	/* SSE2 is part of x86-64; AVX2 is used when the processor reports it */
+	#include <immintrin.h>
+	#define canVectorize 1
+#else
+	#define canVectorize 0
+#endif
+
 // MARK: - Private
 
 #define textMake(N, T) \
@@ -448,6 +456,262 @@ static const char uppers[] = {
 	0
 };
 
+/* flips the case of letters from first to first + 25, up to the first byte that is not ASCII */
+
+static
+int32_t flipCase (const char *i, char *o, int32_t from, int32_t length, char first)
+{
+	for (; from < length && !(i[from] & 0x80); ++from)
+		o[from] = i[from] ^ ((i[from] >= first && i[from] <= first + 25) << 5);
+	
+	return from;
+}
+
+static
+int32_t asciiRun (const char *bytes, int32_t from, int32_t length)
+{
+	while (from < length && !(bytes[from] & 0x80))
+		++from;
+	
+	return from;
+}
+
+static
+int32_t printableRun (const char *bytes, int32_t from, int32_t length, char stop, char otherStop)
+{
+	while (from < length && (uint8_t)(bytes[from] - ' ') < 0x5f && bytes[from] != stop && bytes[from] != otherStop)
+		++from;
+	
+	return from;
+}
+
+/* candidates are positions whose first and last bytes both match the needle's,
+ * tested a whole vector at a time (Muła, "SIMD-friendly algorithms for substring searching") */
+
+static
+const char * findForward (const char *bytes, int32_t from, int32_t to, const char *needle, int32_t length)
+{
+	for (; from < to; ++from)
+		if (bytes[from] == needle[0] && bytes[from + length - 1] == needle[length - 1] && (length <= 2 || !memcmp(bytes + from + 1, needle + 1, length - 2)))
+			return bytes + from;
+	
+	return NULL;
+}
+
+static
+const char * findBackward (const char *bytes, int32_t from, int32_t to, const char *needle, int32_t length)
+{
+	while (to-- > from)
+		if (bytes[to] == needle[0] && bytes[to + length - 1] == needle[length - 1] && (length <= 2 || !memcmp(bytes + to + 1, needle + 1, length - 2)))
+			return bytes + to;
+	
+	return NULL;
+}
+
+#if canVectorize
+
+static
+const char * findSSE2 (const char *bytes, int32_t limit, const char *needle, int32_t length)
+{
+	const __m128i first = _mm_set1_epi8(needle[0]), last = _mm_set1_epi8(needle[length - 1]);
+	int32_t index, bit;
+	uint32_t mask;
+	
+	for (index = 0; index + 16 <= limit; index += 16)
+	{
+		mask = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)(bytes + index))),
+			_mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(bytes + index + length - 1)))));
+		
+		for (; mask; mask &= mask - 1)
+		{
+			bit = __builtin_ctz(mask);
+			if (length <= 2 || !memcmp(bytes + index + bit + 1, needle + 1, length - 2))
+				return bytes + index + bit;
+		}
+	}
+	
+	return findForward(bytes, index, limit, needle, length);
+}
+
+static
+const char * findLastSSE2 (const char *bytes, int32_t limit, const char *needle, int32_t length)
+{
+	const __m128i first = _mm_set1_epi8(needle[0]), last = _mm_set1_epi8(needle[length - 1]);
+	int32_t index, bit;
+	uint32_t mask;
+	
+	for (index = limit - 16; index >= 0; index -= 16)
+	{
+		mask = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)(bytes + index))),
+			_mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(bytes + index + length - 1)))));
+		
+		for (; mask; mask ^= 1u << bit)
+		{
+			bit = 31 - __builtin_clz(mask);
+			if (length <= 2 || !memcmp(bytes + index + bit + 1, needle + 1, length - 2))
+				return bytes + index + bit;
+		}
+	}
+	
+	return findBackward(bytes, 0, index + 16, needle, length);
+}
+
+static
+int32_t flipCaseSSE2 (const char *i, char *o, int32_t length, char first)
+{
+	const __m128i below = _mm_set1_epi8(first - 1), above = _mm_set1_epi8(first + 26), flip = _mm_set1_epi8(0x20);
+	int32_t index;
+	__m128i x;
+	
+	for (index = 0; index + 16 <= length; index += 16)
+	{
+		x = _mm_loadu_si128((const __m128i *)(i + index));
+		if (_mm_movemask_epi8(x))
+			break;
+		
+		_mm_storeu_si128((__m128i *)(o + index), _mm_xor_si128(x, _mm_and_si128(flip, _mm_and_si128(_mm_cmpgt_epi8(x, below), _mm_cmplt_epi8(x, above)))));
+	}
+	
+	return flipCase(i, o, index, length, first);
+}
+
+static
+int32_t asciiSSE2 (const char *bytes, int32_t length)
+{
+	int32_t index;
+	uint32_t mask;
+	
+	for (index = 0; index + 16 <= length; index += 16)
+		if (( mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(bytes + index))) ))
+			return index + __builtin_ctz(mask);
+	
+	return asciiRun(bytes, index, length);
+}
+
+static
+int32_t printableSSE2 (const char *bytes, int32_t length, char stop, char otherStop)
+{
+	const __m128i space = _mm_set1_epi8(' '), del = _mm_set1_epi8(0x7f), stops = _mm_set1_epi8(stop), otherStops = _mm_set1_epi8(otherStop);
+	int32_t index;
+	uint32_t mask;
+	__m128i x;
+	
+	// bytes from 0x80 compare as negative, so they are caught along with controls
+	for (index = 0; index + 16 <= length; index += 16)
+	{
+		x = _mm_loadu_si128((const __m128i *)(bytes + index));
+		mask = _mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_cmplt_epi8(x, space), _mm_cmpeq_epi8(x, del)),
+			_mm_or_si128(_mm_cmpeq_epi8(x, stops), _mm_cmpeq_epi8(x, otherStops))));
+		
+		if (mask)
+			return index + __builtin_ctz(mask);
+	}
+	
+	return printableRun(bytes, index, length, stop, otherStop);
+}
+
+__attribute__((target("avx2")))
+static
+int32_t asciiAVX2 (const char *bytes, int32_t length)
+{
+	int32_t index;
+	uint32_t mask;
+	
+	for (index = 0; index + 32 <= length; index += 32)
+		if (( mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(bytes + index))) ))
+			return index + __builtin_ctz(mask);
+	
+	return asciiRun(bytes, index, length);
+}
+
+__attribute__((target("avx2")))
+static
+int32_t flipCaseAVX2 (const char *i, char *o, int32_t length, char first)
+{
+	const __m256i below = _mm256_set1_epi8(first - 1), above = _mm256_set1_epi8(first + 26), flip = _mm256_set1_epi8(0x20);
+	int32_t index;
+	__m256i x;
+	
+	for (index = 0; index + 32 <= length; index += 32)
+	{
+		x = _mm256_loadu_si256((const __m256i *)(i + index));
+		if (_mm256_movemask_epi8(x))
+			break;
+		
+		_mm256_storeu_si256((__m256i *)(o + index), _mm256_xor_si256(x, _mm256_and_si256(flip, _mm256_and_si256(_mm256_cmpgt_epi8(x, below), _mm256_cmpgt_epi8(above, x)))));
+	}
+	
+	return flipCase(i, o, index, length, first);
+}
+
+__attribute__((target("avx2")))
+static
+const char * findAVX2 (const char *bytes, int32_t limit, const char *needle, int32_t length)
+{
+	const __m256i first = _mm256_set1_epi8(needle[0]), last = _mm256_set1_epi8(needle[length - 1]);
+	int32_t index, bit;
+	uint32_t mask;
+	
+	for (index = 0; index + 32 <= limit; index += 32)
+	{
+		mask = _mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)(bytes + index))),
+			_mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(bytes + index + length - 1)))));
+		
+		for (; mask; mask &= mask - 1)
+		{
+			bit = __builtin_ctz(mask);
+			if (length <= 2 || !memcmp(bytes + index + bit + 1, needle + 1, length - 2))
+				return bytes + index + bit;
+		}
+	}
+	
+	return findForward(bytes, index, limit, needle, length);
+}
+
+__attribute__((target("avx2")))
+static
+const char * findLastAVX2 (const char *bytes, int32_t limit, const char *needle, int32_t length)
+{
+	const __m256i first = _mm256_set1_epi8(needle[0]), last = _mm256_set1_epi8(needle[length - 1]);
+	int32_t index, bit;
+	uint32_t mask;
+	
+	for (index = limit - 32; index >= 0; index -= 32)
+	{
+		mask = _mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)(bytes + index))),
+			_mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(bytes + index + length - 1)))));
+		
+		for (; mask; mask ^= 1u << bit)
+		{
+			bit = 31 - __builtin_clz(mask);
+			if (length <= 2 || !memcmp(bytes + index + bit + 1, needle + 1, length - 2))
+				return bytes + index + bit;
+		}
+	}
+	
+	return findBackward(bytes, 0, index + 32, needle, length);
+}
+
+#endif
+
+static
+int32_t flipASCIICase (const char *i, char *o, int32_t length, char first)
+{
+	#if canVectorize
+	if (length >= 64 && __builtin_cpu_supports("avx2"))
+		return flipCaseAVX2(i, o, length, first);
+	else if (length >= 16)
+		return flipCaseSSE2(i, o, length, first);
+	#endif
+	
+	return flipCase(i, o, 0, length, first);
+}
+
 // MARK: - Methods
 
 struct Text make (const char *bytes, int32_t length)
@@ -467,6 +731,13 @@ struct Text(Char) character (struct Text text)
 {
 	struct Text(Char) c = { 0 };
 	
+	if (text.length && !(text.bytes[0] & 0x80))
+	{
+		c.codepoint = text.bytes[0];
+		c.units = 1;
+		return c;
+	}
+	
 	switch (text.length)
 	{
 		default:
@@ -631,9 +902,18 @@ char * toLower (struct Text i, char *o /* length x 2 */)
 	char buffer[5];
 	const char *p;
 	struct Text(Char) c;
+	int32_t ascii;
 	
 	while (i.length)
 	{
+		// ASCII runs are converted in bulk, other characters through the tables
+		ascii = flipASCIICase(i.bytes, o, i.length, 'A');
+		advance(&i, ascii);
+		o += ascii;
+		
+		if (!i.length)
+			break;
+		
 		c = character(i);
 		memcpy(buffer, i.bytes, c.units);
 		buffer[c.units] = '\0';
@@ -665,9 +945,18 @@ char * toUpper (struct Text i, char *o /* length x 3 */)
 	char buffer[5];
 	const char *p;
 	struct Text(Char) c;
+	int32_t ascii;
 	
 	while (i.length)
 	{
+		// ASCII runs are converted in bulk, other characters through the tables
+		ascii = flipASCIICase(i.bytes, o, i.length, 'a');
+		advance(&i, ascii);
+		o += ascii;
+		
+		if (!i.length)
+			break;
+		
 		c = character(i);
 		memcpy(buffer, i.bytes, c.units);
 		buffer[c.units] = '\0';
@@ -694,6 +983,68 @@ char * toUpper (struct Text i, char *o /* length x 3 */)
 	return o;
 }
 
+int32_t asciiLength (struct Text text)
+{
+	#if canVectorize
+	if (text.length >= 64 && __builtin_cpu_supports("avx2"))
+		return asciiAVX2(text.bytes, text.length);
+	else if (text.length >= 16)
+		return asciiSSE2(text.bytes, text.length);
+	#endif
+	
+	return asciiRun(text.bytes, 0, text.length);
+}
+
+int32_t printableLength (struct Text text, char stop, char otherStop)
+{
+	#if canVectorize
+	if (text.length >= 16)
+		return printableSSE2(text.bytes, text.length, stop, otherStop);
+	#endif
+	
+	return printableRun(text.bytes, 0, text.length, stop, otherStop);
+}
+
+const char * find (struct Text text, struct Text search)
+{
+	int32_t limit = text.length - search.length + 1;
+	
+	if (!search.length)
+		return text.bytes;
+	else if (limit <= 0)
+		return NULL;
+	else if (search.length == 1)
+		return memchr(text.bytes, search.bytes[0], text.length);
+	
+	#if canVectorize
+	if (limit >= 64 && __builtin_cpu_supports("avx2"))
+		return findAVX2(text.bytes, limit, search.bytes, search.length);
+	else if (limit >= 16)
+		return findSSE2(text.bytes, limit, search.bytes, search.length);
+	#endif
+	
+	return findForward(text.bytes, 0, limit, search.bytes, search.length);
+}
+
+const char * findLast (struct Text text, struct Text search)
+{
+	int32_t limit = text.length - search.length + 1;
+	
+	if (!search.length)
+		return text.bytes + text.length;
+	else if (limit <= 0)
+		return NULL;
+	
+	#if canVectorize
+	if (limit >= 64 && __builtin_cpu_supports("avx2"))
+		return findLastAVX2(text.bytes, limit, search.bytes, search.length);
+	else if (limit >= 16)
+		return findLastSSE2(text.bytes, limit, search.bytes, search.length);
+	#endif
+	
+	return findBackward(text.bytes, 0, limit, search.bytes, search.length);
+}
+
 int isSpace (struct Text(Char) c)
 {
 	return
@@ -86,6 +86,12 @@ Interface(Text,
 	(char *, toLower ,(struct Text, char *x2buffer))
 	(char *, toUpper ,(struct Text, char *x3buffer))
 	
+	(int32_t, asciiLength ,(struct Text))
+	(int32_t, printableLength ,(struct Text, char stop, char otherStop))
+	
+	(const char *, find ,(struct Text, struct Text search))
+	(const char *, findLast ,(struct Text, struct Text search))
+	
 	(int, isSpace ,(struct Text(Char)))
 	(int, isDigit ,(struct Text(Char)))
 	(int, isWord ,(struct Text(Char)))
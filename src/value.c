@@ -484,13 +484,13 @@ const char * stringBytes (const struct Value *value)
 	switch (value->type)
 	{
 		case Value(charsType):
-			return value->data.chars->bytes;
+			return Chars.bytesOf(value->data.chars);
 			
 		case Value(textType):
 			return value->data.text->bytes;
 			
 		case Value(stringType):
-			return value->data.string->value->bytes;
+			return Chars.bytesOf(value->data.string->value);
 			
 		case Value(bufferType):
 			return value->data.buffer;
@@ -505,13 +505,13 @@ struct Text textOf (const struct Value *value)
 	switch (value->type)
 	{
 		case Value(charsType):
-			return Text.make(value->data.chars->bytes, value->data.chars->length);
+			return Text.make(Chars.bytesOf(value->data.chars), value->data.chars->length);
 			
 		case Value(textType):
 			return *value->data.text;
 			
 		case Value(stringType):
-			return Text.make(value->data.string->value->bytes, value->data.string->value->length);
+			return Text.make(Chars.bytesOf(value->data.string->value), value->data.string->value->length);
 			
 		case Value(keyType):
 			return *Key.textOf(value->data.key);
@@ -537,8 +537,10 @@ struct Value toObject (struct Context * const context, struct Value value)
 		case Value(integerType):
 			return number(Number.create(value.data.integer));
 		
-		case Value(textType):
 		case Value(charsType):
+			return string(String.create(value.data.chars));
+			
+		case Value(textType):
 		case Value(bufferType):
 			return string(String.create(Chars.createWithBytes(stringLength(&value), stringBytes(&value))));
 			
@@ -716,6 +718,17 @@ struct Value same (struct Context * const context, struct Value a, struct Value
 	return Value(false);
 }
 
+static
+struct Chars * charsOf (struct Value value)
+{
+	if (value.type == Value(charsType))
+		return value.data.chars;
+	else if (value.type == Value(stringType))
+		return value.data.string->value;
+	else
+		return Chars.createWithBytes(stringLength(&value), stringBytes(&value));
+}
+
 struct Value add (struct Context * const context, struct Value a, struct Value b)
 {
 	if (!isNumber(a) || !isNumber(b))
@@ -728,7 +741,22 @@ struct Value add (struct Context * const context, struct Value a, struct Value b
 		{
 			struct Chars(Append) chars;
 			
+			// long results share their operands instead of copying them
+			if (stringLength(&a) + stringLength(&b) >= Chars(ropeLength))
+			{
+				a = toString(context, a);
+				b = toString(context, b);
+				
+				if (!stringLength(&a))
+					return b;
+				else if (!stringLength(&b))
+					return a;
+				else
+					return Value.chars(Chars.createRope(charsOf(a), charsOf(b)));
+			}
+			
 			Chars.beginAppend(&chars);
+			Chars.reserveAppend(&chars, stringLength(&a) + stringLength(&b));
 			Chars.appendValue(&chars, context, a);
 			Chars.appendValue(&chars, context, b);
 			return Chars.endAppend(&chars);
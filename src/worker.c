@@ -0,0 +1,308 @@
+//
+//  worker.c
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#define Implementation
+#include "worker.h"
+
+#if (__unix__ && !__MSDOS__) || (defined(__APPLE__) && defined(__MACH__))
+	#include <pthread.h>
+	#define canThread 1
+#else
+	#define canThread 0
+#endif
+
+// MARK: - Private
+
+#if canThread
+
+struct Worker(Sync) {
+	pthread_mutex_t mutex;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
+	pthread_cond_t finished;
+	pthread_t threads[1];
+};
+
+// MARK: - Static Members
+
+static
+char * copyText (const char *bytes, uint32_t length)
+{
+	char *copy = malloc(length + 1);
+	memcpy(copy, bytes, length);
+	copy[length] = '\0';
+	return copy;
+}
+
+static
+void setResult (struct Worker(Job) *job, struct Value value)
+{
+	job->resultLength = Value.stringLength(&value);
+	job->result = copyText(Value.stringBytes(&value), job->resultLength);
+}
+
+Ecc(useframe)
+static
+enum Worker(State) runJob (struct Ecc *ecc, struct Worker(Job) *job)
+{
+	volatile enum Worker(State) state = Worker(done);
+	struct Input *input;
+	struct Context context = {
+		.environment = &ecc->global->environment,
+		.this = Value.object(&ecc->global->environment),
+		.ecc = ecc,
+	};
+	
+	/* an outer trap keeps the instance from reporting errors on stderr */
+	if (!setjmp(*Ecc.pushEnv(ecc)))
+	{
+		if (job->arguments)
+			Ecc.addValue(ecc, "arguments", JSON.parse(&context, Text.make(job->arguments, (int32_t)strlen(job->arguments))), 0);
+		
+		ecc->stepCountdown = 0;
+		ecc->timeLimit = job->timeout > 0? Env.currentTime() + job->timeout: 0;
+		
+		/* the instance owns the input from here */
+		input = job->input, job->input = NULL;
+		Ecc.evalInput(ecc, input, 0);
+		
+		setResult(job, JSON.stringify(&context, ecc->result));
+	}
+	else
+	{
+		state = ecc->interruptRequest == Ecc(interruptTerminate) && ecc->timeLimit? Worker(timeout): Worker(failed);
+		ecc->interruptRequest = 0;
+		ecc->timeLimit = 0;
+		
+		if (!setjmp(*Ecc.pushEnv(ecc)))
+			setResult(job, Value.toString(&context, ecc->result));
+		else
+			setResult(job, Value.text(&Text(errorName)));
+		
+		Ecc.popEnv(ecc);
+	}
+	
+	Ecc.popEnv(ecc);
+	
+	if (job->input)
+		Input.destroy(job->input), job->input = NULL;
+	
+	/* the next job starts from a fresh global */
+	Ecc.reset(ecc);
+	
+	return state;
+}
+
+static
+void * run (void *data)
+{
+	struct Worker *self = data;
+	struct Worker(Sync) *sync = self->sync;
+	struct Worker(Job) *job;
+	enum Worker(State) state;
+	struct Ecc *ecc = Ecc.create();
+	
+	for (;;)
+	{
+		pthread_mutex_lock(&sync->mutex);
+		
+		while (!self->head && !self->stop)
+			pthread_cond_wait(&sync->notEmpty, &sync->mutex);
+		
+		if (!(job = self->head))
+		{
+			pthread_mutex_unlock(&sync->mutex);
+			break;
+		}
+		
+		if (!(self->head = job->next))
+			self->tail = NULL;
+		
+		--self->queueCount;
+		job->next = NULL;
+		job->state = Worker(running);
+		pthread_cond_signal(&sync->notFull);
+		pthread_mutex_unlock(&sync->mutex);
+		
+		state = runJob(ecc, job);
+		
+		pthread_mutex_lock(&sync->mutex);
+		job->state = state;
+		pthread_cond_broadcast(&sync->finished);
+		pthread_mutex_unlock(&sync->mutex);
+	}
+	
+	Ecc.destroy(ecc), ecc = NULL;
+	
+	return NULL;
+}
+
+static
+struct Worker(Job) * enqueue (struct Worker *self, struct Input *input, const char *arguments, double timeout, int block)
+{
+	struct Worker(Sync) *sync = self->sync;
+	struct Worker(Job) *job;
+	
+	assert(self);
+	assert(input);
+	
+	pthread_mutex_lock(&sync->mutex);
+	
+	while (block && self->queueCount >= self->queueCapacity && !self->stop)
+		pthread_cond_wait(&sync->notFull, &sync->mutex);
+	
+	if (self->queueCount >= self->queueCapacity || self->stop)
+	{
+		pthread_mutex_unlock(&sync->mutex);
+		return NULL;
+	}
+	
+	job = calloc(1, sizeof(*job));
+	job->input = input;
+	job->arguments = arguments? copyText(arguments, (uint32_t)strlen(arguments)): NULL;
+	job->timeout = timeout;
+	job->state = Worker(queued);
+	
+	if (self->tail)
+		self->tail->next = job;
+	else
+		self->head = job;
+	
+	self->tail = job;
+	++self->queueCount;
+	
+	pthread_cond_signal(&sync->notEmpty);
+	pthread_mutex_unlock(&sync->mutex);
+	
+	return job;
+}
+
+#endif
+
+// MARK: - Methods
+
+struct Worker * create (int threadCount, int queueCapacity)
+{
+	struct Worker *self = NULL;
+	
+	#if canThread
+	int index;
+	
+	assert(threadCount > 0);
+	assert(queueCapacity > 0);
+	
+	self = malloc(sizeof(*self));
+	*self = Worker.identity;
+	
+	self->sync = malloc(sizeof(*self->sync) + sizeof(pthread_t) * (threadCount - 1));
+	self->queueCapacity = queueCapacity;
+	
+	pthread_mutex_init(&self->sync->mutex, NULL);
+	pthread_cond_init(&self->sync->notEmpty, NULL);
+	pthread_cond_init(&self->sync->notFull, NULL);
+	pthread_cond_init(&self->sync->finished, NULL);
+	
+	for (index = 0; index < threadCount; ++index)
+		if (!pthread_create(&self->sync->threads[self->threadCount], NULL, run, self))
+			++self->threadCount;
+	
+	if (!self->threadCount)
+		destroy(self), self = NULL;
+	#endif
+	
+	return self;
+}
+
+void destroy (struct Worker *self)
+{
+	#if canThread
+	int index;
+	
+	assert(self);
+	
+	pthread_mutex_lock(&self->sync->mutex);
+	self->stop = 1;
+	pthread_cond_broadcast(&self->sync->notEmpty);
+	pthread_cond_broadcast(&self->sync->notFull);
+	pthread_mutex_unlock(&self->sync->mutex);
+	
+	for (index = 0; index < self->threadCount; ++index)
+		pthread_join(self->sync->threads[index], NULL);
+	
+	pthread_cond_destroy(&self->sync->finished);
+	pthread_cond_destroy(&self->sync->notFull);
+	pthread_cond_destroy(&self->sync->notEmpty);
+	pthread_mutex_destroy(&self->sync->mutex);
+	
+	free(self->sync), self->sync = NULL;
+	free(self), self = NULL;
+	#endif
+}
+
+struct Worker(Job) * submit (struct Worker *self, struct Input *input, const char *arguments, double timeout)
+{
+	#if canThread
+	return enqueue(self, input, arguments, timeout, 1);
+	#else
+	return NULL;
+	#endif
+}
+
+struct Worker(Job) * trySubmit (struct Worker *self, struct Input *input, const char *arguments, double timeout)
+{
+	#if canThread
+	return enqueue(self, input, arguments, timeout, 0);
+	#else
+	return NULL;
+	#endif
+}
+
+enum Worker(State) wait (struct Worker *self, struct Worker(Job) *job)
+{
+	enum Worker(State) state = Worker(failed);
+	
+	#if canThread
+	assert(self);
+	assert(job);
+	
+	pthread_mutex_lock(&self->sync->mutex);
+	
+	while (job->state == Worker(queued) || job->state == Worker(running))
+		pthread_cond_wait(&self->sync->finished, &self->sync->mutex);
+	
+	state = job->state;
+	pthread_mutex_unlock(&self->sync->mutex);
+	#endif
+	
+	return state;
+}
+
+struct Value result (struct Context * const context, struct Worker(Job) *job)
+{
+	assert(job);
+	
+	if (job->state == Worker(done))
+		return JSON.parse(context, Text.make(job->result, job->resultLength));
+	else if (job->result)
+		return Value.error(Error.error(Text(empty), Chars.create("%.*s", job->resultLength, job->result)));
+	else
+		return Value(undefined);
+}
+
+void release (struct Worker(Job) *job)
+{
+	assert(job);
+	assert(job->state != Worker(queued) && job->state != Worker(running));
+	
+	if (job->input)
+		Input.destroy(job->input), job->input = NULL;
+	
+	free(job->arguments), job->arguments = NULL;
+	free(job->result), job->result = NULL;
+	free(job), job = NULL;
+}
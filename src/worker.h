@@ -0,0 +1,65 @@
+//
+//  worker.h
+//  libecc
+//
+//  Copyright (c) 2019 Aurélien Bouilland
+//  Licensed under MIT license, see LICENSE.txt file in project root
+//
+
+#ifndef io_libecc_worker_h
+#ifdef Implementation
+#undef Implementation
+#include __FILE__
+#include "implementation.h"
+#else
+#include "interface.h"
+#define io_libecc_worker_h
+
+	#include "ecc.h"
+	
+	enum Worker(State) {
+		Worker(queued),
+		Worker(running),
+		Worker(done),
+		Worker(failed),
+		Worker(timeout),
+	};
+	
+	struct Worker(Job) {
+		struct Worker(Job) *next;
+		struct Input *input;
+		char *arguments;
+		double timeout;
+		
+		enum Worker(State) state;
+		char *result;
+		uint32_t resultLength;
+	};
+
+#endif
+
+
+Interface(Worker,
+	
+	(struct Worker *, create ,(int threadCount, int queueCapacity))
+	(void, destroy ,(struct Worker *))
+	
+	(struct Worker(Job) *, submit ,(struct Worker *, struct Input *, const char *arguments, double timeout))
+	(struct Worker(Job) *, trySubmit ,(struct Worker *, struct Input *, const char *arguments, double timeout))
+	(enum Worker(State), wait ,(struct Worker *, struct Worker(Job) *))
+	(struct Value, result ,(struct Context * const, struct Worker(Job) *))
+	(void, release ,(struct Worker(Job) *))
+	,
+	{
+		struct Worker(Sync) *sync;
+		int threadCount;
+		
+		struct Worker(Job) *head;
+		struct Worker(Job) *tail;
+		int queueCount;
+		int queueCapacity;
+		int stop;
+	}
+)
+
+#endif